@@ -19,7 +19,11 @@
 #define configTICK_RATE_HZ                      ((TickType_t)1000)
 #define configMAX_PRIORITIES                    5
 #define configMINIMAL_STACK_SIZE                ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE                   ((size_t)(16 * 1024))
+/* Dynamic allocation only. Everything is created at start-up, about 7.9 KB
+   with heap_4's 8 byte block headers: five task stacks and TCBs 5.0 KB,
+   the frag message buffer 0.9 KB, queues, set and semaphore 2.0 KB. The
+   rest of the 20 KB goes to .bss/.data (about 5.7 KB) and the MSP stack. */
+#define configTOTAL_HEAP_SIZE                   ((size_t)(10 * 1024))
 #define configMAX_TASK_NAME_LEN                 16
 #define configUSE_TRACE_FACILITY                0
 #define configUSE_16_BIT_TICKS                  0
@@ -31,21 +35,35 @@
 #define configUSE_RECURSIVE_MUTEXES             0
 #define configUSE_MALLOC_FAILED_HOOK            0
 
+/* make STATIC_ALLOCATION=1: every kernel object is statically allocated
+   and heap_4 is left out, see klbn_rtos.h */
+#ifdef KLBN_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION         1
+#define configSUPPORT_DYNAMIC_ALLOCATION        0
+#else
 #define configSUPPORT_STATIC_ALLOCATION         0
 #define configSUPPORT_DYNAMIC_ALLOCATION        1
+#endif
 
 #define configKERNEL_INTERRUPT_PRIORITY         255
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY    191
 
+/* Highest NVIC priority (0-15) an ISR calling FreeRTOS FromISR APIs may use */
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 11
+
 #define configUSE_TIMERS                        0
 #define configUSE_QUEUE_SETS 1
 
+/* Slot 0 is free for application use, slot 1 is used by the SPI DMA driver */
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   2
+
 /* Required for CMSIS-style interrupt names */
 #define vPortSVCHandler SVC_Handler
 #define xPortPendSVHandler PendSV_Handler
 #define xPortSysTickHandler SysTick_Handler
 
 #define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskDelayUntil 1
 #define INCLUDE_vTaskDelete 1
 #define INCLUDE_xSemaphoreGetMutexHolder 1
 #define INCLUDE_vTaskSuspend 1
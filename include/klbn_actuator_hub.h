@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
  *
@@ -11,10 +10,30 @@
 #ifndef KLBN_ACTUATOR_HUB_H
 #define KLBN_ACTUATOR_HUB_H
 
+#include <stdbool.h>
 #include "klbn_types.h"
 
+// Per actuator, index 0 LED, 1 OLED. Latency runs from the stamp to the
+// end of the apply.
+typedef struct {
+  uint32_t applied;
+  uint32_t coalesced;        // superseded before they were applied
+  uint32_t latency_last_us;
+  uint32_t latency_max_us;
+  uint32_t latency_avg_us;   // smoothed
+} klbn_actuator_stats_t;
+
 void klbn_actuator_hub_init(void);
 void klbn_actuator_hub_apply(const klbn_actuator_command_t *cmd);
 
-#endif // KLBN_ACTUATOR_HUB_H
+// Marks the command's issue time, call before queueing it
+void klbn_actuator_hub_stamp(klbn_actuator_command_t *cmd);
 
+// Actuator hub task: collect everything queued, then apply only the
+// latest command per actuator
+void klbn_actuator_hub_collect(const klbn_actuator_command_t *cmd);
+void klbn_actuator_hub_flush(void);
+
+bool klbn_actuator_hub_get_stats(uint8_t actuator, klbn_actuator_stats_t *out);
+
+#endif // KLBN_ACTUATOR_HUB_H
@@ -14,6 +14,9 @@
 #include "klbn_types.h"
 
 void klbn_led_init(void);
+
+// Starts cmd, or holds it back while a pattern plays its first cycle; the
+// end of the cycle starts it from an interrupt
 void klbn_led_apply(const klbn_led_command_t *cmd);
 
 #endif /* KLBN_LED_H */
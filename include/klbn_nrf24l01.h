@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "klbn_exti_dispatcher.h"
 
 /* NRF24L01 Commands */
 #define NRF24L01_CMD_R_REGISTER         0x00
@@ -54,6 +55,7 @@
 #define NRF24L01_REG_FIFO_STATUS        0x17
 #define NRF24L01_REG_DYNPD              0x1C
 #define NRF24L01_REG_FEATURE            0x1D
+#define NRF24L01_REG_COUNT              0x1E
 
 /* CONFIG Register bits */
 #define NRF24L01_CONFIG_MASK_RX_DR      0x40
@@ -71,6 +73,18 @@
 #define NRF24L01_STATUS_RX_P_NO         0x0E
 #define NRF24L01_STATUS_TX_FULL         0x01
 
+/* FIFO_STATUS Register bits */
+#define NRF24L01_FIFO_STATUS_TX_REUSE   0x40
+#define NRF24L01_FIFO_STATUS_TX_FULL    0x20
+#define NRF24L01_FIFO_STATUS_TX_EMPTY   0x10
+#define NRF24L01_FIFO_STATUS_RX_FULL    0x02
+#define NRF24L01_FIFO_STATUS_RX_EMPTY   0x01
+
+/* FEATURE Register bits */
+#define NRF24L01_FEATURE_EN_DPL         0x04
+#define NRF24L01_FEATURE_EN_ACK_PAY     0x02
+#define NRF24L01_FEATURE_EN_DYN_ACK     0x01
+
 /* RF_SETUP Register bits */
 #define NRF24L01_RF_SETUP_CONT_WAVE     0x80
 #define NRF24L01_RF_SETUP_RF_DR_LOW     0x20
@@ -84,6 +98,16 @@
 #define NRF24L01_DEFAULT_CHANNEL        76
 #define NRF24L01_DEFAULT_RETRIES        3
 #define NRF24L01_DEFAULT_DELAY          5
+#define NRF24L01_PIPE_COUNT             6
+#define NRF24L01_PIPE_ALL               0x3F
+#define NRF24L01_TX_FIFO_DEPTH          3
+#define NRF24L01_TX_QUEUE_LENGTH        8
+#define NRF24L01_ARC_UNKNOWN            0xFF
+#define NRF24L01_MAX_CHANNEL            125
+#define NRF24L01_RPD_DWELL_US           170
+// Power down to standby, 1.5 ms typical and up to 4.5 ms with a slow
+// crystal (datasheet Tpd2stby)
+#define NRF24L01_TPD2STBY_US            4500
 
 /**
  * @brief NRF24L01 error codes
@@ -95,7 +119,8 @@ typedef enum {
     KLBN_NRF24L01_ERROR_TX_FAILED,
     KLBN_NRF24L01_ERROR_RX_EMPTY,
     KLBN_NRF24L01_ERROR_INVALID_PARAM,
-    KLBN_NRF24L01_ERROR_NOT_INITIALIZED
+    KLBN_NRF24L01_ERROR_NOT_INITIALIZED,
+    KLBN_NRF24L01_ERROR_BUSY
 } klbn_nrf24l01_error_t;
 
 /**
@@ -138,9 +163,50 @@ typedef struct {
     uint8_t delay;                          // Auto retransmit delay (0-15)
     bool auto_ack;                          // Enable auto acknowledgment
     bool dynamic_payload;                   // Enable dynamic payload length
-    uint8_t payload_size;                   // Fixed payload size (1-32)
+    uint8_t payload_size;                   // Fixed payload size (1-32), all pipes
+    uint8_t rx_pipes;                       // Enabled RX pipes (bit n = pipe n)
+    bool ack_payload;                       // Carry data on auto-ACKs (implies dynamic payload)
 } klbn_nrf24l01_config_t;
 
+/**
+ * @brief NRF24L01 streaming TX counters
+ */
+typedef struct {
+    uint32_t sent;                          // Payloads delivered (TX_DS)
+    uint32_t failed;                        // Payloads dropped after MAX_RT
+} klbn_nrf24l01_tx_stats_t;
+
+/**
+ * @brief NRF24L01 receive counters
+ */
+typedef struct {
+    uint32_t received;                      // Payloads read from the RX FIFO
+    uint32_t fifo_full_drains;              // Drains that started with all 3 slots
+                                            // used: later payloads may be lost
+} klbn_nrf24l01_rx_stats_t;
+
+/**
+ * @brief Handler for payloads read by klbn_nrf24l01_drain_rx()
+ * @param data Payload (valid only during the call)
+ * @param length Payload length
+ * @param pipe RX pipe the payload arrived on
+ * @param context Pointer passed to klbn_nrf24l01_drain_rx()
+ */
+typedef void (*klbn_nrf24l01_rx_handler_t)(const uint8_t *data, uint8_t length,
+                                           uint8_t pipe, void *context);
+
+/**
+ * @brief Asynchronous transmit completion callback
+ *
+ * Runs from klbn_nrf24l01_service() in the servicing task's context.
+ * @param result KLBN_NRF24L01_OK or KLBN_NRF24L01_ERROR_TX_FAILED (MAX_RT)
+ * @param retransmits Auto retransmits used, NRF24L01_ARC_UNKNOWN if the
+ *                    chip had already moved on to the next payload
+ * @param context Pointer passed to klbn_nrf24l01_transmit_async()
+ */
+typedef void (*klbn_nrf24l01_tx_callback_t)(klbn_nrf24l01_error_t result,
+                                            uint8_t retransmits, void *context);
+
 /**
  * @brief Initialize NRF24L01 module
  * @param config Configuration structure (NULL for default)
@@ -148,6 +214,20 @@ typedef struct {
  */
 klbn_nrf24l01_error_t klbn_nrf24l01_init(const klbn_nrf24l01_config_t *config);
 
+/**
+ * @brief Restore the last written configuration after a radio power loss
+ * @return Error code
+ * @note Rewrites only registers that differ from power-on values, then
+ *       refills the TX FIFO and returns to the previous mode
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_reinit(void);
+
+/**
+ * @brief Check that the radio still holds its configuration
+ * @return true if CONFIG matches the last written value
+ */
+bool klbn_nrf24l01_config_intact(void);
+
 /**
  * @brief Deinitialize NRF24L01 module
  * @return Error code
@@ -161,6 +241,40 @@ klbn_nrf24l01_error_t klbn_nrf24l01_deinit(void);
  */
 klbn_nrf24l01_error_t klbn_nrf24l01_set_mode(klbn_nrf24l01_mode_t mode);
 
+/**
+ * @brief Change data rate and power level at runtime
+ * @param datarate Data rate
+ * @param power TX power level
+ * @return Error code
+ * @note Both ends of a link must use the same data rate
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_set_rf(klbn_nrf24l01_datarate_t datarate,
+                                           klbn_nrf24l01_power_t power);
+
+/**
+ * @brief Change the RF channel at runtime
+ * @param channel RF channel (0-125, 2400 + channel MHz)
+ * @return Error code
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_set_channel(uint8_t channel);
+
+/**
+ * @brief Get the current RF channel
+ * @return RF channel
+ */
+uint8_t klbn_nrf24l01_get_channel(void);
+
+/**
+ * @brief Sample a channel for carriers with the received power detector
+ *
+ * Listens for NRF24L01_RPD_DWELL_US per sample, then returns to the
+ * current channel and mode. Not available while transmitting.
+ * @param channel RF channel to sample (0-125)
+ * @param samples Number of dwell periods
+ * @return Samples that saw more than -64 dBm
+ */
+uint8_t klbn_nrf24l01_sample_carrier(uint8_t channel, uint8_t samples);
+
 /**
  * @brief Set TX address
  * @param address Address buffer (5 bytes)
@@ -175,6 +289,48 @@ klbn_nrf24l01_error_t klbn_nrf24l01_set_tx_address(const uint8_t *address);
  */
 klbn_nrf24l01_error_t klbn_nrf24l01_set_rx_address(const uint8_t *address);
 
+/**
+ * @brief Set RX address for a pipe
+ *
+ * Pipes 0 and 1 take a full 5-byte address. Pipes 2-5 share the upper four
+ * bytes of pipe 1 and only address[0] (the LSB) is written.
+ * @param pipe Pipe number (0-5)
+ * @param address Address buffer
+ * @return Error code
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_set_pipe_address(uint8_t pipe, const uint8_t *address);
+
+/**
+ * @brief Set the fixed payload width of a pipe
+ * @param pipe Pipe number (0-5)
+ * @param size Payload width (1-32)
+ * @return Error code
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_set_pipe_payload_size(uint8_t pipe, uint8_t size);
+
+/**
+ * @brief Enable or disable an RX pipe
+ * @param pipe Pipe number (0-5)
+ * @param enable true to enable
+ * @return Error code
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_enable_pipe(uint8_t pipe, bool enable);
+
+/**
+ * @brief Preload a payload sent back on the next auto-ACK of a pipe
+ *
+ * Requires ack_payload in the configuration. The payload waits in the TX
+ * FIFO until the pipe receives a packet; starting a transmit discards
+ * responses that were not collected.
+ * @param pipe Pipe number (0-5)
+ * @param data Data buffer
+ * @param length Data length (max 32 bytes)
+ * @return Error code (KLBN_NRF24L01_ERROR_BUSY if the TX FIFO is full or
+ *         the radio is transmitting)
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_write_ack_payload(uint8_t pipe, const uint8_t *data,
+                                                      uint8_t length);
+
 /**
  * @brief Transmit data
  * @param data Data buffer
@@ -183,6 +339,67 @@ klbn_nrf24l01_error_t klbn_nrf24l01_set_rx_address(const uint8_t *address);
  */
 klbn_nrf24l01_error_t klbn_nrf24l01_transmit(const uint8_t *data, uint8_t length);
 
+/**
+ * @brief Queue a payload on the streaming TX path
+ *
+ * The first payload puts the radio in TX mode with CE held high. Payloads
+ * are moved into the 3-deep TX FIFO as TX_DS interrupts free it up, and the
+ * radio drops back to RX mode once the queue drains. Call
+ * klbn_nrf24l01_service() whenever the IRQ line fires.
+ * @param data Data buffer
+ * @param length Data length (max 32 bytes)
+ * @return Error code (KLBN_NRF24L01_ERROR_BUSY if the queue is full)
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_stream_write(const uint8_t *data, uint8_t length);
+
+/**
+ * @brief Queue a payload and report its outcome through a callback
+ *
+ * Uses the streaming TX path and returns immediately. The callback fires
+ * from klbn_nrf24l01_service() once the payload is acknowledged or dropped.
+ * @param data Data buffer
+ * @param length Data length (max 32 bytes)
+ * @param callback Completion callback (NULL for none)
+ * @param context Passed back to the callback
+ * @return Error code (KLBN_NRF24L01_ERROR_BUSY if the queue is full)
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_transmit_async(const uint8_t *data, uint8_t length,
+                                                   klbn_nrf24l01_tx_callback_t callback,
+                                                   void *context);
+
+/**
+ * @brief Queue a payload sent without acknowledgment to every listener
+ *
+ * Uses W_TX_PAYLOAD_NO_ACK on the streaming TX path: each copy goes out
+ * once with no retransmits, whatever the number of receivers on the TX
+ * address. Blind repeats cover for packets a listener may miss.
+ * @param data Data buffer
+ * @param length Data length (max 32 bytes)
+ * @param repeats Extra copies sent back to back (0 for a single send)
+ * @return Error code (KLBN_NRF24L01_ERROR_BUSY if the queue cannot take
+ *         all copies)
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_broadcast(const uint8_t *data, uint8_t length,
+                                              uint8_t repeats);
+
+/**
+ * @brief Check if the streaming TX path has drained
+ * @return true if nothing is queued or in flight
+ */
+bool klbn_nrf24l01_stream_idle(void);
+
+/**
+ * @brief Get streaming TX counters
+ * @param stats Output counters
+ */
+void klbn_nrf24l01_get_tx_stats(klbn_nrf24l01_tx_stats_t *stats);
+
+/**
+ * @brief Handle a pending IRQ: retire sent payloads and refill the TX FIFO
+ * @return Status register value read at entry (RX_DR is left for the caller)
+ */
+uint8_t klbn_nrf24l01_service(void);
+
 /**
  * @brief Receive data
  * @param data Data buffer
@@ -191,12 +408,54 @@ klbn_nrf24l01_error_t klbn_nrf24l01_transmit(const uint8_t *data, uint8_t length
  */
 klbn_nrf24l01_error_t klbn_nrf24l01_receive(uint8_t *data, uint8_t *length);
 
+/**
+ * @brief Receive data and report the pipe it arrived on
+ * @param data Data buffer
+ * @param length Pointer to data length
+ * @param pipe Pointer to pipe number (NULL if not needed)
+ * @return Error code
+ */
+klbn_nrf24l01_error_t klbn_nrf24l01_receive_pipe(uint8_t *data, uint8_t *length, uint8_t *pipe);
+
+/**
+ * @brief Read every payload waiting in the RX FIFO
+ *
+ * Loops until FIFO_STATUS reports RX_EMPTY. A full FIFO on entry means
+ * packets may have been dropped since the last drain and is counted in
+ * the RX stats.
+ * @param handler Called once per payload
+ * @param context Passed back to the handler
+ * @return Number of payloads read
+ */
+uint8_t klbn_nrf24l01_drain_rx(klbn_nrf24l01_rx_handler_t handler, void *context);
+
+/**
+ * @brief Read the received power detector
+ * @return true if the last received packet (or, while listening, the
+ *         carrier on the channel) was above -64 dBm
+ */
+bool klbn_nrf24l01_read_rpd(void);
+
+/**
+ * @brief Get receive counters
+ * @param stats Output counters
+ */
+void klbn_nrf24l01_get_rx_stats(klbn_nrf24l01_rx_stats_t *stats);
+
 /**
  * @brief Check if data is available
  * @return true if data available, false otherwise
  */
 bool klbn_nrf24l01_data_available(void);
 
+/**
+ * @brief Check the IRQ line level
+ * @return true while any interrupt flag is still set
+ * @note The EXTI line only sees falling edges: a flag raised while another
+ *       one holds the line low makes no edge, so poll this after servicing
+ */
+bool klbn_nrf24l01_irq_asserted(void);
+
 /**
  * @brief Check if transmission is complete
  * @return true if complete, false otherwise
@@ -209,12 +468,26 @@ bool klbn_nrf24l01_tx_complete(void);
  */
 uint8_t klbn_nrf24l01_get_status(void);
 
+/**
+ * @brief Get the status byte returned by the most recent SPI command
+ *
+ * Costs no SPI traffic, but flags raised since that command are not seen.
+ * @return Cached status register value
+ */
+uint8_t klbn_nrf24l01_get_cached_status(void);
+
 /**
  * @brief Clear status flags
  * @param flags Status flags to clear
  */
 void klbn_nrf24l01_clear_status(uint8_t flags);
 
+/**
+ * @brief Enable the IRQ pin interrupt (EXTI line, falling edge)
+ * @param callback Called from interrupt context whenever IRQ is asserted
+ */
+void klbn_nrf24l01_enable_irq(klbn_exti_callback_t callback);
+
 /**
  * @brief Test if NRF24L01 is present
  * @return true if present, false otherwise
@@ -10,10 +10,33 @@
 #ifndef KLBN_NRF24L01_MODULE_H
 #define KLBN_NRF24L01_MODULE_H
 
+#include "FreeRTOS.h"
+#include "semphr.h"
 #include "klbn_types.h"
+#include "klbn_nrf24l01.h"
 
-void klbn_nrf24l01_module_init(void);
+void klbn_nrf24l01_module_init(SemaphoreHandle_t irq_signal);
 bool klbn_nrf24l01_module_receive(klbn_radio_data_t *out);
-void klbn_nrf24l01_module_send(const klbn_radio_command_t *cmd);
+uint8_t klbn_nrf24l01_module_drain(klbn_radio_rx_handler_t handler,
+                                   void *context);
+uint32_t klbn_nrf24l01_module_rx_overflows(void);
+bool klbn_nrf24l01_module_send(const klbn_radio_command_t *cmd);
+bool klbn_nrf24l01_module_send_async(const klbn_radio_command_t *cmd,
+                                     klbn_radio_tx_callback_t callback,
+                                     void *context);
+bool klbn_nrf24l01_module_broadcast(const klbn_radio_command_t *cmd,
+                                    uint8_t repeats);
+bool klbn_nrf24l01_module_queue_reply(uint8_t pipe,
+                                      const klbn_radio_command_t *cmd);
+void klbn_nrf24l01_module_service(void);
+bool klbn_nrf24l01_module_irq_pending(void);
+bool klbn_nrf24l01_module_set_rf(klbn_nrf24l01_datarate_t datarate,
+                                 klbn_nrf24l01_power_t power);
+bool klbn_nrf24l01_module_set_channel(uint8_t channel);
+uint8_t klbn_nrf24l01_module_get_channel(void);
+bool klbn_nrf24l01_module_tx_idle(void);
+uint8_t klbn_nrf24l01_module_sample_channel(uint8_t channel, uint8_t samples);
+void klbn_nrf24l01_module_check(void);
+bool klbn_nrf24l01_module_open_pipe(uint8_t pipe, const uint8_t *address);
 
 #endif // KLBN_NRF24L01_MODULE_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_ARQ_H
+#define KLBN_RADIO_ARQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "klbn_types.h"
+#include "klbn_radio_frame.h"
+
+// Selective repeat over 8-bit sequence numbers with a single peer. Each
+// ARQ_DATA frame carries the sender's session, its sequence number and the
+// sender's window base. The session is picked at the first send after boot;
+// a new one tells the receiver to start its window over.
+#define KLBN_RADIO_ARQ_WINDOW      8
+#define KLBN_RADIO_ARQ_HEADER_SIZE 3
+#define KLBN_RADIO_ARQ_MAX_PAYLOAD \
+  (KLBN_RADIO_FRAME_MAX_PAYLOAD - KLBN_RADIO_ARQ_HEADER_SIZE)
+#define KLBN_RADIO_ARQ_MAX_RETRIES 10
+
+// Window slots only urgent payloads may take, so a backlog of ordinary
+// ones cannot hold them back for a whole window of retransmits
+#define KLBN_RADIO_ARQ_URGENT_SLOTS 1
+
+#define KLBN_RADIO_ARQ_RTO_MIN_MS  20
+#define KLBN_RADIO_ARQ_RTO_MAX_MS  1000
+#define KLBN_RADIO_ARQ_RTO_INIT_MS 200
+
+typedef struct {
+  uint32_t sent;          // payloads accepted into the window
+  uint32_t retransmits;   // timer or MAX_RT driven resends
+  uint32_t failed;        // given up after KLBN_RADIO_ARQ_MAX_RETRIES
+  uint32_t delivered;     // payloads released in order to the receiver
+  uint32_t duplicates;    // received payloads already seen
+  uint32_t skipped;       // sequence numbers the sender gave up on
+  uint32_t resyncs;       // receive window restarted: new session, or a
+                          // base beyond the window
+  uint16_t srtt_ms;       // smoothed round trip time
+  uint16_t rto_ms;        // current retransmit timeout
+} klbn_radio_arq_stats_t;
+
+void klbn_radio_arq_init(void);
+
+// Radio hub task only. False when the send window is full; payloads that
+// are not urgent leave KLBN_RADIO_ARQ_URGENT_SLOTS of it free.
+bool klbn_radio_arq_send(const uint8_t *data, uint8_t length, bool urgent);
+// Window slots a send could take now; an ARQ_ACK or a given up payload
+// frees more
+uint8_t klbn_radio_arq_room(bool urgent);
+bool klbn_radio_arq_pop(klbn_radio_data_t *out);
+void klbn_radio_arq_update(uint32_t now_ms);
+// Milliseconds to the earliest retransmit, 0 with an ACK or resend
+// waiting, UINT32_MAX when nothing is outstanding. An ACK or resend held
+// back by a full radio queue waits for the TX completion that wakes the
+// hub task.
+uint32_t klbn_radio_arq_next_ms(uint32_t now_ms);
+
+void klbn_radio_arq_handle_data(const uint8_t *payload, uint8_t length,
+                                uint8_t pipe, uint32_t now_ms);
+void klbn_radio_arq_handle_ack(const uint8_t *payload, uint8_t length,
+                               uint32_t now_ms);
+
+void klbn_radio_arq_get_stats(klbn_radio_arq_stats_t *out);
+
+#endif // KLBN_RADIO_ARQ_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_BATCH_H
+#define KLBN_RADIO_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "klbn_types.h"
+#include "klbn_radio_arq.h"
+
+// Records are packed into ARQ payloads as length byte + data
+#define KLBN_RADIO_BATCH_SIZE       KLBN_RADIO_ARQ_MAX_PAYLOAD
+#define KLBN_RADIO_BATCH_MAX_RECORD (KLBN_RADIO_BATCH_SIZE - 1)
+
+// How long a partial batch may wait for more records; 0 sends each
+// record on its own
+#ifndef KLBN_RADIO_BATCH_DEADLINE_MS
+#define KLBN_RADIO_BATCH_DEADLINE_MS 10
+#endif
+
+void klbn_radio_batch_init(void);
+void klbn_radio_batch_set_deadline(uint32_t deadline_ms);
+
+// Radio hub task only. False when the ARQ window has no room for the
+// batch this record pushes out. An urgent record skips the deadline: it
+// goes out at once, in the window slots kept for urgent payloads if need
+// be, and is refused rather than left waiting.
+bool klbn_radio_batch_add(const uint8_t *data, uint8_t length,
+                          bool urgent, uint32_t now_ms);
+// Sends the partial batch once it is full or its deadline passed
+void klbn_radio_batch_update(uint32_t now_ms);
+// Milliseconds left before the partial batch goes out, UINT32_MAX if empty
+// or held back by a full ARQ window
+uint32_t klbn_radio_batch_next_ms(uint32_t now_ms);
+
+// Next received record, unpacked from the payloads the ARQ releases
+bool klbn_radio_batch_pop(klbn_radio_data_t *out);
+
+#endif // KLBN_RADIO_BATCH_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_BENCH_H
+#define KLBN_RADIO_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "klbn_types.h"
+
+typedef enum {
+  KLBN_RADIO_BENCH_NONE = 0,
+  KLBN_RADIO_BENCH_PING,   // round trip latency, the peer echoes probes
+  KLBN_RADIO_BENCH_STREAM, // sustained throughput, the peer counts
+} klbn_radio_bench_mode_t;
+
+// A stream run takes one of two paths. By default it hands frames straight
+// to the hub, ACKed or not, and measures the link below the application
+// stack. A reliable run goes in as bulk commands, through the scheduler,
+// the batcher and the ARQ window like the application's own traffic, and
+// its payloads are capped to KLBN_RADIO_HUB_RELIABLE_MAX.
+
+// Build with -DKLBN_RADIO_BENCH_AUTOSTART=1 (ping) or 2 (stream) to run a
+// benchmark once the boot channel rendezvous is over
+#ifndef KLBN_RADIO_BENCH_AUTOSTART
+#define KLBN_RADIO_BENCH_AUTOSTART KLBN_RADIO_BENCH_NONE
+#endif
+
+#define KLBN_RADIO_BENCH_PING_PROBES      200
+#define KLBN_RADIO_BENCH_PING_INTERVAL_MS 20    // between probe sends
+#define KLBN_RADIO_BENCH_PING_TIMEOUT_MS  200   // unanswered probe is lost
+
+// RTT histogram, the last bin also holds everything slower
+#define KLBN_RADIO_BENCH_HIST_BINS   64
+#define KLBN_RADIO_BENCH_HIST_BIN_US 100
+
+// Stream defaults, see klbn_radio_bench_configure_stream()
+#ifndef KLBN_RADIO_BENCH_STREAM_PAYLOAD
+#define KLBN_RADIO_BENCH_STREAM_PAYLOAD 31    // application bytes per packet
+#endif
+#ifndef KLBN_RADIO_BENCH_STREAM_NO_ACK
+#define KLBN_RADIO_BENCH_STREAM_NO_ACK  0
+#endif
+#ifndef KLBN_RADIO_BENCH_STREAM_RELIABLE
+#define KLBN_RADIO_BENCH_STREAM_RELIABLE 0
+#endif
+#define KLBN_RADIO_BENCH_STREAM_MS      5000
+#define KLBN_RADIO_BENCH_STREAM_MIN_PAYLOAD 5 // marker + sequence number
+
+typedef enum {
+  KLBN_RADIO_BENCH_IDLE = 0,
+  KLBN_RADIO_BENCH_RUNNING,
+  KLBN_RADIO_BENCH_DONE,
+} klbn_radio_bench_state_t;
+
+typedef struct {
+  klbn_radio_bench_state_t state;
+  uint16_t sent;
+  uint16_t received;
+  uint16_t lost;
+  uint32_t min_us;
+  uint32_t avg_us;
+  uint32_t p50_us;    // histogram bin upper edge
+  uint32_t p99_us;
+  uint32_t max_us;
+} klbn_radio_bench_ping_result_t;
+
+typedef struct {
+  klbn_radio_bench_state_t state;
+  bool sender;             // false on the counting end
+  bool no_ack;
+  bool reliable;           // through scheduler, batcher and ARQ
+  uint8_t payload_size;
+  uint8_t rate_level;      // klbn_radio_rate level the run was held at
+  uint32_t duration_ms;
+  uint32_t packets;        // sender: handed to the hub, receiver: unique
+  uint32_t bytes;          // sender: acknowledged (without ACKs or on the
+                           // reliable path, handed over), receiver: unique
+  uint32_t kbps;           // goodput of the bytes above
+  uint32_t duplicates;     // receiver side counts, the sender gets them
+  uint32_t gaps;           // in the peer's report
+  uint32_t peer_bytes;     // sender: the receiver's unique bytes
+  uint32_t peer_kbps;
+} klbn_radio_bench_stream_result_t;
+
+void klbn_radio_bench_init(void);
+
+// Any task; the radio hub task starts the run on its next pass
+void klbn_radio_bench_request(klbn_radio_bench_mode_t mode);
+// Applies to the next stream run started here; no_ack only matters off the
+// reliable path
+void klbn_radio_bench_configure_stream(uint8_t payload_size, bool no_ack,
+                                       bool reliable);
+
+// Radio hub task
+void klbn_radio_bench_update(uint32_t now_ms);
+// Milliseconds until the update has work, UINT32_MAX when idle
+uint32_t klbn_radio_bench_next_ms(uint32_t now_ms);
+void klbn_radio_bench_handle_frame(const uint8_t *payload, uint8_t length);
+// Application data on its way up; true if it was stream traffic, counted
+// and consumed here
+bool klbn_radio_bench_consume(const klbn_radio_data_t *data);
+
+// Any task. Counts follow the run, averages and percentiles are set once
+// state is DONE.
+void klbn_radio_bench_get_ping(klbn_radio_bench_ping_result_t *out);
+void klbn_radio_bench_get_stream(klbn_radio_bench_stream_result_t *out);
+// The benchmark started last, here or by the peer
+klbn_radio_bench_mode_t klbn_radio_bench_get_mode(void);
+
+#endif // KLBN_RADIO_BENCH_H
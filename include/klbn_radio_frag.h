@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_FRAG_H
+#define KLBN_RADIO_FRAG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+// FRAG frame: message id, fragment index, fragment count, then data
+#define KLBN_RADIO_FRAG_HEADER_SIZE   3
+#define KLBN_RADIO_FRAG_PAYLOAD       28
+#define KLBN_RADIO_FRAG_MAX_FRAGMENTS 16
+#define KLBN_RADIO_FRAG_MAX_MESSAGE \
+  (KLBN_RADIO_FRAG_PAYLOAD * KLBN_RADIO_FRAG_MAX_FRAGMENTS)
+
+#define KLBN_RADIO_FRAG_SLOTS      2     // messages reassembled at once
+#define KLBN_RADIO_FRAG_TIMEOUT_MS 500   // partial message lifetime
+#define KLBN_RADIO_FRAG_TX_BUFFER  (2 * (KLBN_RADIO_FRAG_MAX_MESSAGE + 4))
+
+// Runs in the radio hub task once all fragments of a message are in
+typedef void (*klbn_radio_frag_handler_t)(const uint8_t *data, uint16_t length,
+                                          uint8_t pipe, void *context);
+
+void klbn_radio_frag_init(void);
+void klbn_radio_frag_set_handler(klbn_radio_frag_handler_t handler,
+                                 void *context);
+
+// Queue a message for sending, from any task
+bool klbn_radio_frag_send(const uint8_t *data, uint16_t length,
+                          TickType_t wait);
+
+// Radio hub task: feed fragments to the radio and expire partial messages
+void klbn_radio_frag_update(uint32_t now_ms);
+// Milliseconds until the update has work, UINT32_MAX when idle
+uint32_t klbn_radio_frag_next_ms(uint32_t now_ms);
+void klbn_radio_frag_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint8_t pipe, uint32_t now_ms);
+
+// Messages abandoned: partial ones timed out, outgoing ones that failed
+uint32_t klbn_radio_frag_get_dropped(void);
+
+#endif // KLBN_RADIO_FRAG_H
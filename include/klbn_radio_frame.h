@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_FRAME_H
+#define KLBN_RADIO_FRAME_H
+
+#include <stdint.h>
+
+// Every radio payload starts with a frame type byte. The radio hub adds it
+// to application data and routes link-control frames to their owners.
+typedef enum {
+  KLBN_RADIO_FRAME_DATA = 0,  // application payload
+  KLBN_RADIO_FRAME_RATE,      // data rate / power change handshake
+  KLBN_RADIO_FRAME_SCAN,      // channel occupancy exchange at boot
+  KLBN_RADIO_FRAME_HOP,       // hopping beacon from the master
+  KLBN_RADIO_FRAME_FRAG,      // fragment of a message over 31 bytes
+  KLBN_RADIO_FRAME_ARQ_DATA,  // sequenced application payload
+  KLBN_RADIO_FRAME_ARQ_ACK,   // cumulative + selective acknowledgment
+  KLBN_RADIO_FRAME_BENCH,     // link benchmark probe or echo
+} klbn_radio_frame_type_t;
+
+#define KLBN_RADIO_FRAME_HEADER_SIZE 1
+#define KLBN_RADIO_FRAME_MAX_SIZE    32
+#define KLBN_RADIO_FRAME_MAX_PAYLOAD \
+  (KLBN_RADIO_FRAME_MAX_SIZE - KLBN_RADIO_FRAME_HEADER_SIZE)
+
+#endif // KLBN_RADIO_FRAME_H
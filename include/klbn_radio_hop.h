@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_HOP_H
+#define KLBN_RADIO_HOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  KLBN_RADIO_HOP_OFF = 0,
+  KLBN_RADIO_HOP_MASTER,  // owns the clock, channel set and blacklist
+  KLBN_RADIO_HOP_SLAVE,   // follows the master's beacons
+} klbn_radio_hop_role_t;
+
+// Build with -DKLBN_RADIO_HOP_ROLE=1 (master) or 2 (slave) to start hopping
+// once the boot channel rendezvous is over
+#ifndef KLBN_RADIO_HOP_ROLE
+#define KLBN_RADIO_HOP_ROLE KLBN_RADIO_HOP_OFF
+#endif
+
+#ifndef KLBN_RADIO_HOP_SEED
+#define KLBN_RADIO_HOP_SEED 0x4B4C424EUL
+#endif
+
+#define KLBN_RADIO_HOP_MAX_CHANNELS 16
+#define KLBN_RADIO_HOP_DWELL_MS     50   // time spent on each channel
+
+// Hopping channel set. The first channel is the anchor: every few slots
+// land on it, and a slave that lost the master parks there to resync.
+// Master only, slaves take the set from the beacons.
+bool klbn_radio_hop_set_channels(const uint8_t *channels, uint8_t count);
+
+void klbn_radio_hop_start(klbn_radio_hop_role_t role, uint32_t seed,
+                          uint32_t now_ms);
+void klbn_radio_hop_stop(void);
+void klbn_radio_hop_update(uint32_t now_ms);
+// Milliseconds to the next slot boundary, UINT32_MAX while not hopping
+uint32_t klbn_radio_hop_next_ms(uint32_t now_ms);
+void klbn_radio_hop_handle_frame(const uint8_t *payload, uint8_t length,
+                                 uint32_t now_ms);
+
+bool klbn_radio_hop_synced(void);
+
+// Bit n set: channel n of the set is blacklisted
+uint16_t klbn_radio_hop_get_blacklist(void);
+
+#endif // KLBN_RADIO_HOP_H
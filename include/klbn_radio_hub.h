@@ -11,10 +11,60 @@
 #define KLBN_RADIO_HUB_H
 
 #include <stdbool.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
 #include "klbn_types.h"
+#include "klbn_radio_frag.h"
+#include "klbn_radio_batch.h"
 
-void klbn_radio_hub_init(void);
+// Longest command klbn_radio_hub_send_reliable() takes, 27 bytes: a
+// klbn_radio_command_t holds more, but the frame type, ARQ header and
+// batch record length all come out of one 32 byte payload
+#define KLBN_RADIO_HUB_RELIABLE_MAX KLBN_RADIO_BATCH_MAX_RECORD
+
+// irq_signal is the hub task's wake-up: given by the radio IRQ and by
+// anything that queues traffic for it
+void klbn_radio_hub_init(SemaphoreHandle_t irq_signal);
 bool klbn_radio_hub_receive(klbn_radio_data_t *out);
-void klbn_radio_hub_send(const klbn_radio_command_t *cmd);
+uint8_t klbn_radio_hub_drain(klbn_radio_rx_handler_t handler, void *context);
+// Receive loss: drains that found the chip's RX FIFO full, where payloads
+// arriving meanwhile were lost, and payloads the drain handler refused
+uint32_t klbn_radio_hub_rx_overflows(void);
+uint32_t klbn_radio_hub_rx_dropped(void);
+bool klbn_radio_hub_send(const klbn_radio_command_t *cmd);
+bool klbn_radio_hub_send_async(const klbn_radio_command_t *cmd,
+                               klbn_radio_tx_callback_t callback,
+                               void *context);
+// Retransmitted until the peer's ARQ layer has it, delivered in order.
+// Short records share a payload, sent when full or after the batch
+// deadline. At most KLBN_RADIO_HUB_RELIABLE_MAX bytes; false when the
+// ARQ window is full or the command is longer.
+bool klbn_radio_hub_send_reliable(const klbn_radio_command_t *cmd);
+// As above; urgent commands skip the batch deadline and may take the ARQ
+// window slots kept for them, and are refused rather than left waiting
+bool klbn_radio_hub_send_reliable_urgent(const klbn_radio_command_t *cmd,
+                                         bool urgent);
+void klbn_radio_hub_set_batch_deadline(uint32_t deadline_ms);
+// Sends a frame of the given klbn_radio_frame_type_t; application data
+// goes through klbn_radio_hub_send(), at most KLBN_RADIO_FRAME_MAX_PAYLOAD
+bool klbn_radio_hub_send_frame(uint8_t type, const uint8_t *payload,
+                               uint8_t length,
+                               klbn_radio_tx_callback_t callback,
+                               void *context);
+// Messages up to KLBN_RADIO_FRAG_MAX_MESSAGE bytes, split into fragments
+bool klbn_radio_hub_send_message(const uint8_t *data, uint16_t length,
+                                 TickType_t wait);
+void klbn_radio_hub_set_message_handler(klbn_radio_frag_handler_t handler,
+                                        void *context);
+bool klbn_radio_hub_broadcast(const klbn_radio_command_t *cmd, uint8_t repeats);
+bool klbn_radio_hub_queue_reply(uint8_t pipe, const klbn_radio_command_t *cmd);
+void klbn_radio_hub_service(void);
+// True while the radio still holds an interrupt flag; service and drain
+// again, no new IRQ edge will come for it
+bool klbn_radio_hub_irq_pending(void);
+// Timed upkeep of the link modules. Returns the milliseconds until it
+// next has work, the hub task sleeps that long unless woken.
+uint32_t klbn_radio_hub_check(void);
+bool klbn_radio_hub_open_pipe(uint8_t pipe, const uint8_t *address);
 
 #endif /* KLBN_RADIO_HUB_H */
\ No newline at end of file
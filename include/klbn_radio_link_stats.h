@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_LINK_STATS_H
+#define KLBN_RADIO_LINK_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "klbn_types.h"
+
+// One link per RX pipe. Sends go to the TX address, whose auto-ACKs come
+// back on pipe 0, so transmit counters accrue on link 0.
+#define KLBN_RADIO_LINK_COUNT 6
+#define KLBN_RADIO_LINK_TX    0
+
+// Radio-wide totals, summed over every link
+#define KLBN_RADIO_LINK_ALL   0xFF
+
+// Window over which the rolling rates are sampled
+#define KLBN_RADIO_LINK_RATE_PERIOD_MS 1000
+
+typedef struct {
+  uint32_t sent;          // payloads handed to the radio
+  uint32_t acked;         // payloads acknowledged (TX_DS)
+  uint32_t retransmits;   // ARC retransmits of acknowledged payloads
+  uint32_t arc_samples;   // acknowledged payloads whose ARC was known
+  uint32_t lost;          // payloads dropped after all retries (MAX_RT/PLOS)
+  uint32_t received;      // payloads read from the RX FIFO
+  uint32_t rx_overflows;  // drains that found the RX FIFO full (radio-wide,
+                          // totals only)
+  uint32_t rpd_samples;   // RPD readings taken after a receive
+  uint32_t rpd_hits;      // readings above -64 dBm (RPD set)
+} klbn_radio_link_counters_t;
+
+// Rolling rates, smoothed over a few sampling periods
+typedef struct {
+  uint16_t tx_per_sec;        // payloads sent per second
+  uint16_t rx_per_sec;        // payloads received per second
+  uint16_t delivery_permille; // acked / (acked + lost)
+  uint16_t retransmits_x10;   // mean retransmits per ARC sample, x10
+  uint16_t rpd_permille;      // RPD readings that were set
+} klbn_radio_link_rates_t;
+
+void klbn_radio_link_stats_init(void);
+
+// Event recording, from the radio hub task
+// retransmits may be KLBN_RADIO_RETRANSMITS_UNKNOWN: a streamed payload
+// completing behind another has no ARC reading of its own
+void klbn_radio_link_stats_tx(uint8_t link, bool acked, uint8_t retransmits);
+void klbn_radio_link_stats_rx(uint8_t link);
+void klbn_radio_link_stats_rpd(uint8_t link, bool hit);
+void klbn_radio_link_stats_overflow(uint32_t count);
+
+// Fold the counters into the rolling rates once per period
+void klbn_radio_link_stats_update(uint32_t now_ms);
+
+// Queries; link is a pipe number or KLBN_RADIO_LINK_ALL
+bool klbn_radio_link_stats_get(uint8_t link, klbn_radio_link_counters_t *out);
+bool klbn_radio_link_stats_get_rates(uint8_t link, klbn_radio_link_rates_t *out);
+
+#endif // KLBN_RADIO_LINK_STATS_H
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_RATE_H
+#define KLBN_RADIO_RATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Rate/power ladder, from most robust to fastest and quietest. Both ends
+// start on, and fall back to, the base level.
+#define KLBN_RADIO_RATE_LEVELS     6
+#define KLBN_RADIO_RATE_BASE_LEVEL 1
+
+void klbn_radio_rate_init(void);
+
+// Evaluate the link statistics and drive the change handshake
+void klbn_radio_rate_update(uint32_t now_ms);
+// Milliseconds to the next decision window or confirm timeout
+uint32_t klbn_radio_rate_next_ms(uint32_t now_ms);
+
+// RATE frame payload from the peer
+void klbn_radio_rate_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint32_t now_ms);
+
+uint8_t klbn_radio_rate_get_level(void);
+
+// Stop (or resume) automatic changes; a disabled engine still follows the peer
+void klbn_radio_rate_enable(bool enable);
+
+#endif // KLBN_RADIO_RATE_H
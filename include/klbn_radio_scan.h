@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_SCAN_H
+#define KLBN_RADIO_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KLBN_RADIO_SCAN_CHANNELS 126
+#define KLBN_RADIO_SCAN_SAMPLES  16   // RPD dwell samples per channel
+
+// Occupancy is kept as 0 (never busy) to 15 (busy on every sample)
+#define KLBN_RADIO_SCAN_LEVEL_MAX 15
+
+// Sweep every channel and fill occupancy[KLBN_RADIO_SCAN_CHANNELS]
+void klbn_radio_scan_sweep(uint8_t samples, uint8_t *occupancy);
+
+// Boot rendezvous: sweep, exchange histograms with the peer on the current
+// channel, then move both ends to the channel quietest for both. The sweep
+// busy-waits about 340 ms, call it from the hub task.
+//
+// Afterwards an idle link is probed; when nothing is acked or received for
+// 8 s the exchange runs again on the boot channel, and a peer's SCAN frame
+// there restarts it, so a node that reboots alone is found again.
+void klbn_radio_scan_start(uint32_t now_ms);
+void klbn_radio_scan_update(uint32_t now_ms);
+// Milliseconds to the next resend, channel switch or probe, UINT32_MAX
+// before the start
+uint32_t klbn_radio_scan_next_ms(uint32_t now_ms);
+void klbn_radio_scan_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint32_t now_ms);
+
+// False again while a lost link is being rejoined
+bool klbn_radio_scan_done(void);
+
+// Local occupancy from the last sweep, 0-15 per channel
+uint8_t klbn_radio_scan_get_occupancy(uint8_t channel);
+
+#endif // KLBN_RADIO_SCAN_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RADIO_SCHED_H
+#define KLBN_RADIO_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "klbn_types.h"
+
+typedef enum {
+  KLBN_RADIO_CLASS_CONTROL = 0,   // always first, see below
+  KLBN_RADIO_CLASS_INTERACTIVE,   // shares the rest with bulk by weight
+  KLBN_RADIO_CLASS_BULK,
+  KLBN_RADIO_CLASS_COUNT,
+} klbn_radio_class_t;
+
+// A control command goes ahead of the other classes here, skips the batch
+// deadline and has an ARQ window slot kept for it. What it can still wait
+// behind is the radio's TX queue (NRF24L01_TX_QUEUE_LENGTH frames, each at
+// most NRF24L01_DEFAULT_RETRIES + 1 attempts), a control payload already
+// in flight and its own ARQ retransmits when lost.
+
+// Queue depth per class
+#define KLBN_RADIO_SCHED_CONTROL_DEPTH     4
+#define KLBN_RADIO_SCHED_INTERACTIVE_DEPTH 4
+#define KLBN_RADIO_SCHED_BULK_DEPTH        8
+
+// Commands interactive gets per bulk one when both are backlogged
+#define KLBN_RADIO_SCHED_INTERACTIVE_WEIGHT 3
+#define KLBN_RADIO_SCHED_BULK_WEIGHT        1
+
+typedef struct {
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t dropped;   // class queue was full, or the command too long
+} klbn_radio_class_stats_t;
+
+// Hands a command to the radio, false when it has no room for now. Control
+// commands are urgent.
+typedef bool (*klbn_radio_sched_send_t)(const klbn_radio_command_t *cmd,
+                                        bool urgent);
+
+// wake is given on every enqueue, the radio hub task blocks on it
+void klbn_radio_sched_init(SemaphoreHandle_t wake);
+
+// Any task. Drops and counts the command when its class queue is full or
+// it is longer than KLBN_RADIO_HUB_RELIABLE_MAX: send() could never take
+// it, and it would block its class at the head of the queue.
+bool klbn_radio_sched_enqueue(const klbn_radio_command_t *cmd,
+                              klbn_radio_class_t cls);
+// Commands the class queue still takes, for a producer that would rather
+// wait than have them dropped
+uint8_t klbn_radio_sched_room(klbn_radio_class_t cls);
+
+// Radio hub task: sends queued commands in class order until send refuses
+void klbn_radio_sched_service(klbn_radio_sched_send_t send);
+
+void klbn_radio_sched_get_stats(klbn_radio_class_t cls,
+                                klbn_radio_class_stats_t *out);
+
+#endif // KLBN_RADIO_SCHED_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#ifndef KLBN_RTOS_H
+#define KLBN_RTOS_H
+
+#include "FreeRTOS.h"
+#include "message_buffer.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+// Kernel object creation for both allocation modes.
+//
+// With KLBN_STATIC_ALLOCATION (make STATIC_ALLOCATION=1) each object lives
+// in the storage passed here and the FreeRTOS heap is left out of the
+// build, so the map file shows the whole RAM budget. Otherwise the storage
+// arguments are dropped unexpanded and the object comes from heap_4: the
+// storage only has to be declared under KLBN_STATIC_ALLOCATION.
+//
+// Queue storage is length * item size bytes, queue set storage length *
+// sizeof(QueueSetMemberHandle_t), message buffer storage size + 1 bytes.
+
+#ifdef KLBN_STATIC_ALLOCATION
+
+// True when the task was created
+#define KLBN_TASK_CREATE(fn, name, depth, params, prio, stack, tcb)          \
+  (xTaskCreateStatic((fn), (name), (depth), (params), (prio), (stack),        \
+                     (tcb)) != NULL)
+
+#define KLBN_QUEUE_CREATE(length, item_size, storage, buffer)                \
+  xQueueCreateStatic((length), (item_size), (storage), (buffer))
+
+#define KLBN_QUEUE_SET_CREATE(length, storage, buffer)                       \
+  xQueueCreateSetStatic((length), (storage), (buffer))
+
+#define KLBN_SEMAPHORE_CREATE_BINARY(buffer)                                 \
+  xSemaphoreCreateBinaryStatic(buffer)
+
+#define KLBN_MESSAGE_BUFFER_CREATE(size, storage, buffer)                    \
+  xMessageBufferCreateStatic((size), (storage), (buffer))
+
+#else
+
+#define KLBN_TASK_CREATE(fn, name, depth, params, prio, stack, tcb)          \
+  (xTaskCreate((fn), (name), (depth), (params), (prio), NULL) == pdPASS)
+
+#define KLBN_QUEUE_CREATE(length, item_size, storage, buffer)                \
+  xQueueCreate((length), (item_size))
+
+#define KLBN_QUEUE_SET_CREATE(length, storage, buffer)                       \
+  xQueueCreateSet(length)
+
+#define KLBN_SEMAPHORE_CREATE_BINARY(buffer)                                 \
+  xSemaphoreCreateBinary()
+
+#define KLBN_MESSAGE_BUFFER_CREATE(size, storage, buffer)                    \
+  xMessageBufferCreate(size)
+
+#endif // KLBN_STATIC_ALLOCATION
+
+#endif // KLBN_RTOS_H
@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
  *
@@ -15,8 +14,28 @@
 #include "task.h"
 #include "klbn_types.h"
 
+typedef struct {
+  uint32_t periods;          // wakeups run
+  uint32_t overruns;         // wakeups whose deadline had passed at the wait
+  uint32_t skipped;          // sensor samples dropped to catch up
+  int32_t jitter_min_us;     // wake interval minus deadline interval
+  int32_t jitter_max_us;
+  uint32_t jitter_avg_us;    // smoothed absolute deviation
+} klbn_sensor_hub_timing_t;
+
 void klbn_sensor_hub_init();
-bool klbn_sensor_hub_read(klbn_sensor_data_t *out);
+bool klbn_sensor_hub_set_period(klbn_sensor_id_t sensor, uint32_t period_ms);
 
-#endif // KLBN_SENSOR_HUB_H
+// Tick the earliest sensor is due at; the sensor hub task sleeps until it
+TickType_t klbn_sensor_hub_next_due(void);
 
+// Sensor hub task, once per wakeup. deadline is the tick the wait
+// returned for, on_time false if it had already passed. Fills out with
+// the sensors due and returns how many.
+uint8_t klbn_sensor_hub_sample(TickType_t deadline, bool on_time,
+                               klbn_sensor_data_t out[KLBN_SENSOR_COUNT]);
+
+void klbn_sensor_hub_get_timing(klbn_sensor_hub_timing_t *out);
+void klbn_sensor_hub_reset_timing(void);
+
+#endif // KLBN_SENSOR_HUB_H
@@ -22,9 +22,15 @@ typedef enum {
     KLBN_SPI_ERROR_TIMEOUT,
     KLBN_SPI_ERROR_BUSY,
     KLBN_SPI_ERROR_NULL_PTR,
-    KLBN_SPI_ERROR_NOT_INITIALIZED
+    KLBN_SPI_ERROR_NOT_INITIALIZED,
+    KLBN_SPI_ERROR_DMA
 } klbn_spi_error_t;
 
+/**
+ * @brief Transfers of at least this many bytes issued from a task use DMA
+ */
+#define KLBN_SPI_DMA_MIN_LENGTH 8
+
 /**
  * @brief SPI configuration structure
  */
@@ -65,6 +71,18 @@ uint8_t klbn_spi_transfer(uint8_t tx_data);
  */
 klbn_spi_error_t klbn_spi_transfer_multi(const uint8_t *tx_data, uint8_t *rx_data, size_t length);
 
+/**
+ * @brief Transfer multiple bytes using DMA1 channel 2 (RX) and channel 3 (TX)
+ *
+ * The calling task blocks on a task notification until the transfer-complete
+ * interrupt fires. Only call from a task while the scheduler is running.
+ * @param tx_data Transmit buffer (NULL for receive-only)
+ * @param rx_data Receive buffer (NULL for transmit-only)
+ * @param length Number of bytes to transfer (max 65535)
+ * @return Error code
+ */
+klbn_spi_error_t klbn_spi_transfer_dma(const uint8_t *tx_data, uint8_t *rx_data, size_t length);
+
 /**
  * @brief Set chip select low (start communication)
  */
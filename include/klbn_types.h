@@ -36,8 +36,14 @@ typedef struct {
 } klbn_mode_button_event_t;
 
 
+typedef enum {
+  KLBN_SENSOR_HEARTBEAT = 0,   // placeholder until real sensors are wired
+  KLBN_SENSOR_COUNT,
+} klbn_sensor_id_t;
+
 typedef struct {
-  uint32_t timestamp;
+  uint32_t timestamp;   // the sampling deadline, in ticks
+  klbn_sensor_id_t sensor;
 } klbn_sensor_data_t;
 
 //-----------------------
@@ -46,6 +52,7 @@ typedef struct {
 typedef struct {
   uint8_t data[32];
   uint8_t length;
+  uint8_t pipe;       // RX pipe (0-5) the payload arrived on
   uint32_t timestamp;
 } klbn_radio_data_t;
 
@@ -54,6 +61,20 @@ typedef struct {
   uint8_t length;
 } klbn_radio_command_t;
 
+typedef enum {
+  KLBN_RADIO_TX_OK = 0,
+  KLBN_RADIO_TX_FAILED,   // no acknowledgment after all retries
+} klbn_radio_tx_result_t;
+
+#define KLBN_RADIO_RETRANSMITS_UNKNOWN 0xFF
+
+typedef void (*klbn_radio_tx_callback_t)(klbn_radio_tx_result_t result,
+                                         uint8_t retransmits, void *context);
+
+// False when the consumer had no room for the payload
+typedef bool (*klbn_radio_rx_handler_t)(const klbn_radio_data_t *data,
+                                        void *context);
+
 // Pairing types removed
 
 //-----------------------
@@ -85,16 +106,31 @@ typedef enum {
   KLBN_LED_MODE_BLINK,
 } klbn_led_mode_t;
 
+// Played in KLBN_LED_MODE_BLINK; NONE is a plain on/off blink
+typedef enum {
+  KLBN_LED_PATTERN_NONE = 0,
+  KLBN_LED_PATTERN_BREATHE,
+  KLBN_LED_PATTERN_PULSE2,   // two short pulses, then a pause
+  KLBN_LED_PATTERN_PULSE3,   // three short pulses, then a pause
+} klbn_led_pattern_t;
+
 typedef struct {
   klbn_led_mode_t mode;
-  uint16_t blink_speed_ms;
-  uint8_t pattern_id;
-  uint8_t brightness;
+  uint16_t blink_speed_ms;  // step length of KLBN_LED_PATTERN_NONE
+  uint8_t pattern_id;       // klbn_led_pattern_t
+  uint8_t brightness;       // percent
 } klbn_led_command_t;
 
+// Which parts of a klbn_actuator_command_t are meant to be applied
+#define KLBN_ACTUATOR_LED  (1 << 0)
+#define KLBN_ACTUATOR_OLED (1 << 1)
+#define KLBN_ACTUATOR_COUNT 2
+
 typedef struct {
   klbn_oled_command_t oled;
   klbn_led_command_t led;
+  uint8_t targets;          // KLBN_ACTUATOR_* bits
+  uint32_t issued;          // DWT cycles, set by klbn_actuator_hub_stamp()
 } klbn_actuator_command_t;
 
 #endif // KLBN_TYPES_H
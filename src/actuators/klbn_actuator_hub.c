@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
  *
@@ -12,6 +11,38 @@
 #include "klbn_oled.h"
 #include "klbn_actuator_hub.h"
 #include "klbn_types.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32f1xx.h"
+
+#define ACTUATOR_LED  0
+#define ACTUATOR_OLED 1
+
+#define LATENCY_SHIFT 3   // smoothing weight 1/8 per apply
+
+// Latest command per actuator, waiting for the flush
+static klbn_led_command_t pending_led;
+static klbn_oled_command_t pending_oled;
+static uint32_t pending_issued[KLBN_ACTUATOR_COUNT];
+static uint8_t pending_targets = 0;
+
+static klbn_actuator_stats_t stats[KLBN_ACTUATOR_COUNT];
+
+static void record_latency(uint8_t actuator, uint32_t issued) {
+  uint32_t latency_us =
+      (DWT->CYCCNT - issued) / (SystemCoreClock / 1000000);
+  klbn_actuator_stats_t *s = &stats[actuator];
+
+  taskENTER_CRITICAL();
+  s->applied++;
+  s->latency_last_us = latency_us;
+  if (latency_us > s->latency_max_us) {
+    s->latency_max_us = latency_us;
+  }
+  s->latency_avg_us = s->latency_avg_us +
+                      ((int32_t)(latency_us - s->latency_avg_us) >> LATENCY_SHIFT);
+  taskEXIT_CRITICAL();
+}
 
 void klbn_actuator_hub_init(void) {
   klbn_led_init();
@@ -22,6 +53,61 @@ void klbn_actuator_hub_apply(const klbn_actuator_command_t *cmd) {
   if (!cmd)
     return;
 
-  klbn_led_apply(&cmd->led);
-  klbn_oled_apply(&cmd->oled);
+  klbn_actuator_hub_collect(cmd);
+  klbn_actuator_hub_flush();
+}
+
+void klbn_actuator_hub_stamp(klbn_actuator_command_t *cmd) {
+  if (!cmd)
+    return;
+
+  cmd->issued = DWT->CYCCNT;
+}
+
+void klbn_actuator_hub_collect(const klbn_actuator_command_t *cmd) {
+  if (!cmd)
+    return;
+
+  if (cmd->targets & KLBN_ACTUATOR_LED) {
+    if (pending_targets & KLBN_ACTUATOR_LED) {
+      stats[ACTUATOR_LED].coalesced++;
+    }
+    pending_led = cmd->led;
+    pending_issued[ACTUATOR_LED] = cmd->issued;
+  }
+
+  if (cmd->targets & KLBN_ACTUATOR_OLED) {
+    if (pending_targets & KLBN_ACTUATOR_OLED) {
+      stats[ACTUATOR_OLED].coalesced++;
+    }
+    pending_oled = cmd->oled;
+    pending_issued[ACTUATOR_OLED] = cmd->issued;
+  }
+
+  pending_targets |= cmd->targets & (KLBN_ACTUATOR_LED | KLBN_ACTUATOR_OLED);
+}
+
+void klbn_actuator_hub_flush(void) {
+  // The LED is a queue write, the OLED a full I2C frame: LED first
+  if (pending_targets & KLBN_ACTUATOR_LED) {
+    klbn_led_apply(&pending_led);
+    record_latency(ACTUATOR_LED, pending_issued[ACTUATOR_LED]);
+  }
+
+  if (pending_targets & KLBN_ACTUATOR_OLED) {
+    klbn_oled_apply(&pending_oled);
+    record_latency(ACTUATOR_OLED, pending_issued[ACTUATOR_OLED]);
+  }
+
+  pending_targets = 0;
+}
+
+bool klbn_actuator_hub_get_stats(uint8_t actuator, klbn_actuator_stats_t *out) {
+  if (!out || actuator >= KLBN_ACTUATOR_COUNT)
+    return false;
+
+  taskENTER_CRITICAL();
+  *out = stats[actuator];
+  taskEXIT_CRITICAL();
+  return true;
 }
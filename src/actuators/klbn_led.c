@@ -8,107 +8,264 @@
  */
 
 #include "klbn_led.h"
-#include "FreeRTOS.h"
 #include "klbn_gpio.h"
 #include "klbn_types.h"
-#include "queue.h"
 #include "stm32f1xx.h"
-#include "task.h"
 #include "klbn_pins.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdbool.h>
+
+// PC13 has no timer channel, so the PWM is made by DMA writes to the GPIOC
+// BSRR, with no task:
+//   TIM4 update  -> DMA1 channel 7 -> BSRR, LED on  (start of each period)
+//   TIM4 CC1     -> DMA1 channel 1 -> BSRR, LED off (CCR1 = duty)
+//   TIM1 update  -> DMA1 channel 5 -> TIM4->CCR1    (next pattern step)
+// Channel 5 sets its transfer complete flag as the pattern wraps, which
+// marks the end of the first full cycle. Its interrupt is enabled only
+// while a command waits for that.
+
+#define LED_PWM_TICK_HZ   1000000   // TIM4 counter clock
+#define LED_PWM_PERIOD    1000      // ticks, 1 kHz PWM
+#define LED_STEP_TICK_HZ  2000      // TIM1 counter clock
+#define LED_STEP_MAX_MS   (0xFFFF / (LED_STEP_TICK_HZ / 1000))
+
+#define LED_MAX_STEPS 32
+
+typedef struct {
+  uint16_t step_ms;        // 0 plays blink_speed_ms instead
+  uint8_t length;
+  uint8_t levels[LED_MAX_STEPS];   // percent of the command's brightness
+} led_pattern_t;
+
+// Indexed by klbn_led_pattern_t
+static const led_pattern_t led_patterns[] = {
+    [KLBN_LED_PATTERN_NONE] = {0, 2, {100, 0}},
+    [KLBN_LED_PATTERN_BREATHE] =
+        {60, 32, {0,   6,   13,  19,  25,  31,  38,  44,  50,  56,  63,
+                  69,  75,  81,  88,  94,  100, 94,  88,  81,  75,  69,
+                  63,  56,  50,  44,  38,  31,  25,  19,  13,  6}},
+    [KLBN_LED_PATTERN_PULSE2] = {100, 10, {100, 0, 100, 0, 0, 0, 0, 0, 0, 0}},
+    [KLBN_LED_PATTERN_PULSE3] =
+        {100, 12, {100, 0, 100, 0, 100, 0, 0, 0, 0, 0, 0, 0}},
+};
+
+#define LED_PATTERN_COUNT (sizeof(led_patterns) / sizeof(led_patterns[0]))
+
+static const uint32_t led_on_bits = 1UL << KLBN_LED_ONBOARD_PIN;
+static const uint32_t led_off_bits = 1UL << (KLBN_LED_ONBOARD_PIN + 16);
+
+// CCR1 values the step DMA walks through
+static uint16_t led_steps[LED_MAX_STEPS];
+
+static klbn_led_command_t current_cmd;
+static bool current_valid = false;
+
+// Held back until the running pattern has played once, started from the
+// channel 5 interrupt; shared with it under a critical section
+static klbn_led_command_t deferred_cmd;
+static volatile bool deferred_valid = false;
+
+// Percent of full scale to CCR1 ticks, squared so equal steps look equal
+static uint16_t duty_ticks(uint8_t level, uint8_t brightness) {
+  uint32_t percent = (uint32_t)level * brightness / 100;
+  return (uint16_t)(percent * percent * LED_PWM_PERIOD / 10000);
+}
+
+// Clearing DIER also drops DMA requests left over from the last run
+static void led_stop(void) {
+  TIM1->CR1 &= ~TIM_CR1_CEN;
+  TIM4->CR1 &= ~TIM_CR1_CEN;
+  TIM1->DIER = 0;
+  TIM4->DIER = 0;
+  DMA1_Channel1->CCR = 0;
+  DMA1_Channel5->CCR = 0;
+  DMA1_Channel7->CCR = 0;
+  DMA1->IFCR = DMA_IFCR_CGIF5;
+}
+
+static void led_run_pwm(uint16_t duty) {
+  // At CCR1 = 0 both requests fire together: the on write has the higher
+  // priority, so the off write lands last
+  DMA1_Channel7->CCR = DMA_CCR_PL | DMA_CCR_CIRC | DMA_CCR_DIR |
+                       DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1;
+  DMA1_Channel1->CCR = DMA_CCR_CIRC | DMA_CCR_DIR |
+                       DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1;
+  DMA1_Channel7->CNDTR = 1;
+  DMA1_Channel1->CNDTR = 1;
+  DMA1_Channel7->CCR |= DMA_CCR_EN;
+  DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+  TIM4->CCR1 = duty;
+  TIM4->CNT = 0;
+  KLBN_LED_ONBOARD_PORT->BSRR = duty ? led_on_bits : led_off_bits;
+  TIM4->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE;
+  TIM4->CR1 |= TIM_CR1_CEN;
+}
+
+// Runs the PWM at a fixed duty; 0 and full scale need no timer at all
+static void led_start_pwm(uint16_t duty) {
+  if (duty == 0) {
+    KLBN_LED_ONBOARD_PORT->BSRR = led_off_bits;
+    return;
+  }
+  if (duty >= LED_PWM_PERIOD) {
+    KLBN_LED_ONBOARD_PORT->BSRR = led_on_bits;
+    return;
+  }
+
+  led_run_pwm(duty);
+}
 
-// Internal state for blinking
-#define LED_TASK_INTERVAL_MS 10
+static void led_start_pattern(const led_pattern_t *pattern, uint16_t step_ms,
+                              uint8_t brightness) {
+  uint8_t length = pattern->length;
 
-#define LED_TASK_STACK_SIZE 256
-#define LED_TASK_PRIORITY 2
-#define LED_QUEUE_LENGTH 1
+  // The first step is loaded by hand and the DMA picks up from the second,
+  // so the buffer starts one step in
+  for (uint8_t i = 0; i < length; i++) {
+    led_steps[i] = duty_ticks(pattern->levels[(i + 1) % length], brightness);
+  }
+
+  if (step_ms == 0) {
+    step_ms = 1;
+  }
+  if (step_ms > LED_STEP_MAX_MS) {
+    step_ms = LED_STEP_MAX_MS;
+  }
 
-static void klbn_led_on(void);
-static void klbn_led_off(void);
-static void vLedTask(void *pvParameters);
+  TIM1->ARR = step_ms * (LED_STEP_TICK_HZ / 1000) - 1;
+  TIM1->CNT = 0;
 
-static QueueHandle_t led_command_queue = NULL;
-static TaskHandle_t led_task_handle = NULL;
+  DMA1_Channel5->CCR = DMA_CCR_PL_0 | DMA_CCR_CIRC | DMA_CCR_DIR |
+                       DMA_CCR_MINC | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;
+  DMA1_Channel5->CMAR = (uint32_t)led_steps;
+  DMA1_Channel5->CNDTR = length;
+  DMA1_Channel5->CCR |= DMA_CCR_EN;
+
+  // Steps only move CCR1, so levels 0 and 100 keep the PWM running too
+  led_run_pwm(duty_ticks(pattern->levels[0], brightness));
+  TIM1->DIER = TIM_DIER_UDE;
+  TIM1->CR1 |= TIM_CR1_CEN;
+}
+
+static bool pattern_playing(void) {
+  return current_valid && current_cmd.mode == KLBN_LED_MODE_BLINK &&
+         current_cmd.pattern_id != KLBN_LED_PATTERN_NONE &&
+         !(DMA1->ISR & DMA_ISR_TCIF5);
+}
+
+static bool same_command(const klbn_led_command_t *a,
+                         const klbn_led_command_t *b) {
+  return a->mode == b->mode && a->blink_speed_ms == b->blink_speed_ms &&
+         a->pattern_id == b->pattern_id && a->brightness == b->brightness;
+}
 
 void klbn_led_init(void) {
   klbn_gpio_config_output((uint32_t)KLBN_LED_ONBOARD_PORT, KLBN_LED_ONBOARD_PIN);
   klbn_gpio_config_output((uint32_t)KLBN_LED_DEBUG_PORT, KLBN_LED_DEBUG_PIN);
-      
-  if (led_command_queue == NULL) {
-    led_command_queue =
-        xQueueCreate(LED_QUEUE_LENGTH, sizeof(klbn_led_command_t));
-    configASSERT(led_command_queue != NULL);
+
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  RCC->APB1ENR |= RCC_APB1ENR_TIM4EN;
+  RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+
+  led_stop();
+
+  DMA1_Channel7->CPAR = (uint32_t)&KLBN_LED_ONBOARD_PORT->BSRR;
+  DMA1_Channel7->CMAR = (uint32_t)&led_on_bits;
+  DMA1_Channel1->CPAR = (uint32_t)&KLBN_LED_ONBOARD_PORT->BSRR;
+  DMA1_Channel1->CMAR = (uint32_t)&led_off_bits;
+  DMA1_Channel5->CPAR = (uint32_t)&TIM4->CCR1;
+
+  // Both timers run from SystemCoreClock (APB1 x2, APB2 x1). CC1 stays in
+  // frozen mode with its output disabled, only its DMA request is used.
+  TIM4->CR1 = 0;
+  TIM4->PSC = SystemCoreClock / LED_PWM_TICK_HZ - 1;
+  TIM4->ARR = LED_PWM_PERIOD - 1;
+  TIM4->CCMR1 = 0;
+  TIM4->CCER = 0;
+  TIM4->EGR = TIM_EGR_UG;
+  TIM4->SR = 0;
+
+  TIM1->CR1 = 0;
+  TIM1->PSC = SystemCoreClock / LED_STEP_TICK_HZ - 1;
+  TIM1->RCR = 0;
+  TIM1->EGR = TIM_EGR_UG;
+  TIM1->SR = 0;
+
+  KLBN_LED_ONBOARD_PORT->BSRR = led_off_bits;
+  current_valid = false;
+  deferred_valid = false;
+
+  // Masked by critical sections, like the other driver interrupts
+  NVIC_SetPriority(DMA1_Channel5_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+  NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+}
+
+static void led_start(const klbn_led_command_t *cmd) {
+  current_cmd = *cmd;
+  current_valid = true;
+
+  uint8_t brightness = (cmd->brightness > 100) ? 100 : cmd->brightness;
+
+  led_stop();
+
+  switch (cmd->mode) {
+  case KLBN_LED_MODE_ON:
+    led_start_pwm(duty_ticks(100, brightness));
+    break;
+
+  case KLBN_LED_MODE_BLINK: {
+    uint8_t id =
+        (cmd->pattern_id < LED_PATTERN_COUNT) ? cmd->pattern_id : 0;
+    const led_pattern_t *pattern = &led_patterns[id];
+    uint16_t step_ms = pattern->step_ms ? pattern->step_ms : cmd->blink_speed_ms;
+    led_start_pattern(pattern, step_ms, brightness);
+    break;
   }
 
-  if (led_task_handle == NULL) {
-    BaseType_t result = xTaskCreate(vLedTask, "LEDTask", LED_TASK_STACK_SIZE,
-                                    NULL, LED_TASK_PRIORITY, &led_task_handle);
-    configASSERT(result == pdPASS);
-    if (result != pdPASS) {}
+  case KLBN_LED_MODE_OFF:
+  default:
+    led_start_pwm(0);
+    break;
   }
 }
 
 void klbn_led_apply(const klbn_led_command_t *cmd) {
-  if (!cmd || !led_command_queue)
+  if (!cmd)
     return;
-  xQueueOverwrite(led_command_queue, cmd);
-}
 
-static void klbn_led_on(void) {
-  klbn_gpio_set_pin((uint32_t)KLBN_LED_ONBOARD_PORT, KLBN_LED_ONBOARD_PIN);
-}
+  taskENTER_CRITICAL();
 
-static void klbn_led_off(void) {
-  klbn_gpio_clear_pin((uint32_t)KLBN_LED_ONBOARD_PORT, KLBN_LED_ONBOARD_PIN);
+  // Producers resend the same state; restarting would reset the pattern
+  if (current_valid && same_command(cmd, &current_cmd)) {
+    deferred_valid = false;
+  } else if (pattern_playing()) {
+    // A pattern signals an event, let it finish; the latest command waits.
+    // A flag already set by now raises the interrupt as soon as it is
+    // enabled.
+    deferred_cmd = *cmd;
+    deferred_valid = true;
+    DMA1_Channel5->CCR |= DMA_CCR_TCIE;
+  } else {
+    deferred_valid = false;
+    led_start(cmd);
+  }
+
+  taskEXIT_CRITICAL();
 }
 
-static void vLedTask(void *pvParameters) {
-  (void)pvParameters;
-  klbn_led_command_t current_cmd = {.mode = KLBN_LED_MODE_OFF,
-				    .blink_speed_ms = 200};
-  TickType_t last_toggle_tick = xTaskGetTickCount();
-  bool led_state = false;
-
-  for (;;) {
-    klbn_led_command_t received_cmd;
-
-    // Check for new command (non-blocking)
-    if (xQueueReceive(led_command_queue, &received_cmd, 0) == pdPASS) {
-      current_cmd = received_cmd;
-    }
-
-    switch (current_cmd.mode) {
-    case KLBN_LED_MODE_OFF:
-      klbn_led_off();
-      led_state = false;
-      break;
-
-    case KLBN_LED_MODE_ON:
-      klbn_led_on();
-      led_state = true;
-      break;
-
-    case KLBN_LED_MODE_BLINK: {
-      TickType_t now = xTaskGetTickCount();
-      if ((now - last_toggle_tick) >=
-          pdMS_TO_TICKS(current_cmd.blink_speed_ms)) {
-        led_state = !led_state;
-        if (led_state) {
-          klbn_led_on();
-        } else {
-          klbn_led_off();
-        }
-        last_toggle_tick = now;
-      }
-      break;
-    }
-
-    default:
-      klbn_led_off();
-      led_state = false;
-      break;
-    }
-
-    vTaskDelay(pdMS_TO_TICKS(10));
+/**
+ * @brief Pattern step DMA wrapped: the first cycle is over, start the
+ * command held back behind it
+ */
+void DMA1_Channel5_IRQHandler(void) {
+  // The flag stays set, it tells pattern_playing() the cycle is done
+  DMA1_Channel5->CCR &= ~DMA_CCR_TCIE;
+
+  if (deferred_valid) {
+    deferred_valid = false;
+    led_start(&deferred_cmd);
   }
 }
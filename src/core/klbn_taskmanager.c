@@ -9,14 +9,14 @@
 
 #include "klbn_taskmanager.h"
 
-#include "FreeRTOS.h"
-#include "queue.h"
-#include "task.h"
+#include "klbn_rtos.h"
 
 #include "klbn_actuator_hub.h"
 #include "klbn_controller.h"
 #include "klbn_sensor_hub.h"
+#include "klbn_radio_bench.h"
 #include "klbn_radio_hub.h"
+#include "klbn_radio_sched.h"
 
 #include "klbn_mode_button.h"
 
@@ -42,61 +42,150 @@ static void handle_radio_data(void);
 #define ACTUATOR_HUB_TASK_PRIORITY 2
 #define RADIO_HUB_TASK_PRIORITY 2
 
+// Service passes per wakeup while the nRF24L01 IRQ line stays low
+#define RADIO_HUB_IRQ_PASSES 4
+
+#define SENSOR_DATA_QUEUE_LENGTH 5
+#define ACTUATOR_CMD_QUEUE_LENGTH 5
+#define MODE_BUTTON_QUEUE_LENGTH 5
+#define RADIO_DATA_QUEUE_LENGTH 5
+
+// Room for every item any member queue can hold
+#define CONTROLLER_QUEUE_SET_LENGTH                                          \
+  (SENSOR_DATA_QUEUE_LENGTH + MODE_BUTTON_QUEUE_LENGTH +                     \
+   RADIO_DATA_QUEUE_LENGTH)
+
 // --- Queues ---
 static QueueHandle_t xSensorDataQueue = NULL;
 static QueueHandle_t xActuatorCmdQueue = NULL;
 static QueueHandle_t xModeButtonQueue = NULL;
 static QueueHandle_t xRadioDataQueue = NULL;
-static QueueHandle_t xRadioCmdQueue = NULL;
 
 static QueueSetHandle_t xControllerQueueSet = NULL;
 
+// --- Semaphores ---
+static SemaphoreHandle_t xRadioWakeSemaphore = NULL;
+
+#ifdef KLBN_STATIC_ALLOCATION
+// --- Static storage ---
+static StackType_t xSensorHubStack[SENSOR_HUB_TASK_STACK];
+static StackType_t xControllerStack[CONTROLLER_TASK_STACK];
+static StackType_t xActuatorHubStack[ACTUATOR_HUB_TASK_STACK];
+static StackType_t xRadioHubStack[RADIO_HUB_TASK_STACK];
+static StaticTask_t xSensorHubTcb;
+static StaticTask_t xControllerTcb;
+static StaticTask_t xActuatorHubTcb;
+static StaticTask_t xRadioHubTcb;
+
+static uint8_t ucSensorDataStorage[SENSOR_DATA_QUEUE_LENGTH *
+                                   sizeof(klbn_sensor_data_t)];
+static uint8_t ucActuatorCmdStorage[ACTUATOR_CMD_QUEUE_LENGTH *
+                                    sizeof(klbn_actuator_command_t)];
+static uint8_t ucModeButtonStorage[MODE_BUTTON_QUEUE_LENGTH *
+                                   sizeof(klbn_mode_button_event_t)];
+static uint8_t ucRadioDataStorage[RADIO_DATA_QUEUE_LENGTH *
+                                  sizeof(klbn_radio_data_t)];
+static uint8_t ucControllerSetStorage[CONTROLLER_QUEUE_SET_LENGTH *
+                                      sizeof(QueueSetMemberHandle_t)];
+static StaticQueue_t xSensorDataQueueStruct;
+static StaticQueue_t xActuatorCmdQueueStruct;
+static StaticQueue_t xModeButtonQueueStruct;
+static StaticQueue_t xRadioDataQueueStruct;
+static StaticQueue_t xControllerQueueSetStruct;
+
+static StaticSemaphore_t xRadioWakeSemaphoreStruct;
+
+static StackType_t xIdleStack[configMINIMAL_STACK_SIZE];
+static StaticTask_t xIdleTcb;
+
+// The kernel asks for the idle task's memory when the scheduler starts
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
+                                   StackType_t **ppxIdleTaskStackBuffer,
+                                   configSTACK_DEPTH_TYPE *puxIdleTaskStackSize) {
+  *ppxIdleTaskTCBBuffer = &xIdleTcb;
+  *ppxIdleTaskStackBuffer = xIdleStack;
+  *puxIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+#endif
+
 void klbn_taskmanager_setup(void) {
   // Always create sensor + actuator command queues
-  xSensorDataQueue = xQueueCreate(5, sizeof(klbn_sensor_data_t));
+  xSensorDataQueue = KLBN_QUEUE_CREATE(SENSOR_DATA_QUEUE_LENGTH,
+                                       sizeof(klbn_sensor_data_t),
+                                       ucSensorDataStorage,
+                                       &xSensorDataQueueStruct);
   configASSERT(xSensorDataQueue != NULL);
 
-  xActuatorCmdQueue = xQueueCreate(5, sizeof(klbn_actuator_command_t));
+  xActuatorCmdQueue = KLBN_QUEUE_CREATE(ACTUATOR_CMD_QUEUE_LENGTH,
+                                        sizeof(klbn_actuator_command_t),
+                                        ucActuatorCmdStorage,
+                                        &xActuatorCmdQueueStruct);
   configASSERT(xActuatorCmdQueue != NULL);
 
   // Event queues
-  xModeButtonQueue = xQueueCreate(5, sizeof(klbn_mode_button_event_t));
+  xModeButtonQueue = KLBN_QUEUE_CREATE(MODE_BUTTON_QUEUE_LENGTH,
+                                       sizeof(klbn_mode_button_event_t),
+                                       ucModeButtonStorage,
+                                       &xModeButtonQueueStruct);
   configASSERT(xModeButtonQueue != NULL);
 
-  xRadioDataQueue = xQueueCreate(5, sizeof(klbn_radio_data_t));
+  xRadioDataQueue = KLBN_QUEUE_CREATE(RADIO_DATA_QUEUE_LENGTH,
+                                      sizeof(klbn_radio_data_t),
+                                      ucRadioDataStorage,
+                                      &xRadioDataQueueStruct);
   configASSERT(xRadioDataQueue != NULL);
 
-  xRadioCmdQueue = xQueueCreate(5, sizeof(klbn_radio_command_t));
-  configASSERT(xRadioCmdQueue != NULL);
-
   // Queue set
-  xControllerQueueSet = xQueueCreateSet(15);
+  xControllerQueueSet = KLBN_QUEUE_SET_CREATE(CONTROLLER_QUEUE_SET_LENGTH,
+                                              ucControllerSetStorage,
+                                              &xControllerQueueSetStruct);
   configASSERT(xControllerQueueSet != NULL);
 
   xQueueAddToSet(xSensorDataQueue, xControllerQueueSet);
   xQueueAddToSet(xModeButtonQueue, xControllerQueueSet);
   xQueueAddToSet(xRadioDataQueue, xControllerQueueSet);
 
+  // Wakes the radio hub task: given by the nRF24L01 IRQ line and by
+  // outgoing traffic
+  xRadioWakeSemaphore = KLBN_SEMAPHORE_CREATE_BINARY(&xRadioWakeSemaphoreStruct);
+  configASSERT(xRadioWakeSemaphore != NULL);
+
+  // Outgoing radio commands, one queue per traffic class
+  klbn_radio_sched_init(xRadioWakeSemaphore);
+
   // Init all modules
   klbn_sensor_hub_init();
   klbn_actuator_hub_init();
-  klbn_radio_hub_init();
+  klbn_radio_hub_init(xRadioWakeSemaphore);
   klbn_controller_init();
 
   klbn_mode_button_init(xModeButtonQueue);
 
   // Tasks (always run sensor and actuator hub)
-  xTaskCreate(vSensorHubTask, "SensorHub", SENSOR_HUB_TASK_STACK, NULL,
-              SENSOR_HUB_TASK_PRIORITY, NULL);
-
-  xTaskCreate(vControllerTask, "Controller", CONTROLLER_TASK_STACK, NULL,
-              CONTROLLER_TASK_PRIORITY, NULL);
-
-  xTaskCreate(vActuatorHubTask, "ActuatorHub", ACTUATOR_HUB_TASK_STACK, NULL,
-              ACTUATOR_HUB_TASK_PRIORITY, NULL);
-
-  xTaskCreate(vRadioHubTask, "RadioHub", RADIO_HUB_TASK_STACK, NULL,
-              RADIO_HUB_TASK_PRIORITY, NULL);
+  BaseType_t created =
+      KLBN_TASK_CREATE(vSensorHubTask, "SensorHub", SENSOR_HUB_TASK_STACK,
+                       NULL, SENSOR_HUB_TASK_PRIORITY, xSensorHubStack,
+                       &xSensorHubTcb);
+  configASSERT(created);
+
+  created =
+      KLBN_TASK_CREATE(vControllerTask, "Controller", CONTROLLER_TASK_STACK,
+                       NULL, CONTROLLER_TASK_PRIORITY, xControllerStack,
+                       &xControllerTcb);
+  configASSERT(created);
+
+  created =
+      KLBN_TASK_CREATE(vActuatorHubTask, "ActuatorHub", ACTUATOR_HUB_TASK_STACK,
+                       NULL, ACTUATOR_HUB_TASK_PRIORITY, xActuatorHubStack,
+                       &xActuatorHubTcb);
+  configASSERT(created);
+
+  created =
+      KLBN_TASK_CREATE(vRadioHubTask, "RadioHub", RADIO_HUB_TASK_STACK,
+                       NULL, RADIO_HUB_TASK_PRIORITY, xRadioHubStack,
+                       &xRadioHubTcb);
+  configASSERT(created);
+  (void)created;
 }
 
 void klbn_taskmanager_start(void) { vTaskStartScheduler(); }
@@ -104,13 +193,26 @@ void klbn_taskmanager_start(void) { vTaskStartScheduler(); }
 // --- Tasks ---
 static void vSensorHubTask(void *pvParameters) {
   (void)pvParameters;
-  klbn_sensor_data_t sensor_data;
+  klbn_sensor_data_t samples[KLBN_SENSOR_COUNT];
+  TickType_t last_wake = xTaskGetTickCount();
 
   for (;;) {
-    if (klbn_sensor_hub_read(&sensor_data)) {
-      xQueueSendToBack(xSensorDataQueue, &sensor_data, 0);
+    // Sleep until the earliest sensor is due. Absolute deadlines: read
+    // time and preemption do not stretch the period.
+    TickType_t delay = klbn_sensor_hub_next_due() - last_wake;
+    BaseType_t on_time;
+    if ((int32_t)delay > 0) {
+      on_time = xTaskDelayUntil(&last_wake, delay);
+    } else {
+      // Due already: the first samples after init are due at once
+      on_time = (delay == 0) ? pdTRUE : pdFALSE;
+      last_wake += delay;
+    }
+
+    uint8_t count = klbn_sensor_hub_sample(last_wake, on_time == pdTRUE, samples);
+    for (uint8_t i = 0; i < count; i++) {
+      xQueueSendToBack(xSensorDataQueue, &samples[i], 0);
     }
-    vTaskDelay(pdMS_TO_TICKS(100));
   }
 }
 
@@ -139,31 +241,55 @@ static void vActuatorHubTask(void *pvParameters) {
   klbn_actuator_command_t command;
 
   for (;;) {
-    if (xQueueReceive(xActuatorCmdQueue, &command, pdMS_TO_TICKS(10)) ==
-        pdPASS) {
-      klbn_actuator_hub_apply(&command);
+    if (xQueueReceive(xActuatorCmdQueue, &command, portMAX_DELAY) == pdPASS) {
+      // Anything queued behind it is newer: keep the latest per actuator
+      do {
+        klbn_actuator_hub_collect(&command);
+      } while (xQueueReceive(xActuatorCmdQueue, &command, 0) == pdPASS);
+
+      klbn_actuator_hub_flush();
     }
-    vTaskDelay(pdMS_TO_TICKS(50));
   }
 }
 
+// A full queue refuses the payload, the hub counts it as dropped
+static bool radio_data_received(const klbn_radio_data_t *data, void *context) {
+  (void)context;
+  return xQueueSendToBack(xRadioDataQueue, data, 0) == pdPASS;
+}
+
 static void vRadioHubTask(void *pvParameters) {
   (void)pvParameters;
-  klbn_radio_data_t radio_data;
-  klbn_radio_command_t radio_cmd;
+  TickType_t wait = 0;
 
   for (;;) {
-    // Check for incoming radio data
-    if (klbn_radio_hub_receive(&radio_data)) {
-      xQueueSendToBack(xRadioDataQueue, &radio_data, 0);
-    }
-    
-    // Check for outgoing radio commands
-    if (xQueueReceive(xRadioCmdQueue, &radio_cmd, 0) == pdPASS) {
-      klbn_radio_hub_send(&radio_cmd);
+    // Sleep until the radio raises IRQ, traffic is queued or the next
+    // timed upkeep is due
+    // Timeouts service the radio too: it costs two register reads, and an
+    // IRQ edge lost anyway is picked up within one sleep
+    xSemaphoreTake(xRadioWakeSemaphore, wait);
+
+    // A flag raised while another held the IRQ line low made no edge, so
+    // keep going until the line is released
+    uint8_t passes = 0;
+    do {
+      // Retire sent payloads and top up the TX FIFO
+      klbn_radio_hub_service();
+
+      // Empty the chip's RX FIFO in one pass before it can overflow
+      klbn_radio_hub_drain(radio_data_received, NULL);
+    } while (klbn_radio_hub_irq_pending() && ++passes < RADIO_HUB_IRQ_PASSES);
+
+    // Hand outgoing commands to the ARQ window, control first
+    klbn_radio_sched_service(klbn_radio_hub_send_reliable_urgent);
+
+    // Brownout recovery, retransmits and link upkeep. Work held back by a
+    // full radio queue or ARQ window waits for the TX completion or ARQ_ACK
+    // that frees it, both of which give the semaphore.
+    wait = pdMS_TO_TICKS(klbn_radio_hub_check());
+    if (wait == 0) {
+      wait = 1;
     }
-    
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
 
@@ -174,6 +300,7 @@ static void handle_sensor_data(void) {
 
   if (xQueueReceive(xSensorDataQueue, &sensor_data, 0) == pdPASS) {
     klbn_controller_process(&sensor_data, &command);
+    klbn_actuator_hub_stamp(&command);
     xQueueSendToBack(xActuatorCmdQueue, &command, 0);
   }
 }
@@ -187,7 +314,10 @@ static void handle_mode_button_event(void) {
 
   if (xQueueReceive(xModeButtonQueue, &event, 0) == pdPASS) {
     klbn_controller_process_mode_button(&event, &command);
-    xQueueSendToBack(xActuatorCmdQueue, &command, 0);
+    if (command.targets) {
+      klbn_actuator_hub_stamp(&command);
+      xQueueSendToBack(xActuatorCmdQueue, &command, 0);
+    }
     
     // Handle different button events
     if (event.event_type == KLBN_MODE_BUTTON_EVENT_PRESSED) {
@@ -197,7 +327,15 @@ static void handle_mode_button_event(void) {
       for (uint8_t i = 0; i < 5; i++) {
         radio_cmd.data[i] = message[i];
       }
-      xQueueSendToBack(xRadioCmdQueue, &radio_cmd, 0);
+      klbn_radio_sched_enqueue(&radio_cmd, KLBN_RADIO_CLASS_INTERACTIVE);
+    } else if (event.event_type == KLBN_MODE_BUTTON_EVENT_LONG_PRESS) {
+      // Measure the link, latency and throughput in turn; the results
+      // replace the idle screen
+      static bool bench_stream = false;
+      klbn_radio_bench_request(bench_stream ? KLBN_RADIO_BENCH_STREAM
+                                            : KLBN_RADIO_BENCH_PING);
+      bench_stream = !bench_stream;
+      xSemaphoreGive(xRadioWakeSemaphore);
     }
   }
 }
@@ -207,11 +345,13 @@ static void handle_radio_data(void) {
   klbn_actuator_command_t command;
 
   if (xQueueReceive(xRadioDataQueue, &radio_data, 0) == pdPASS) {
-    // Simple LED flash when receiving any message
+    // Double pulse when receiving any message
     command.led.mode = KLBN_LED_MODE_BLINK;
     command.led.blink_speed_ms = 200;
-    command.led.pattern_id = 1;
+    command.led.pattern_id = KLBN_LED_PATTERN_PULSE2;
     command.led.brightness = 100;
+    command.targets = KLBN_ACTUATOR_LED;
+    klbn_actuator_hub_stamp(&command);
     xQueueSendToBack(xActuatorCmdQueue, &command, 0);
   }
 }
@@ -13,6 +13,7 @@
 #include "klbn_pins.h"
 #include "klbn_delay.h"
 #include "stm32f1xx.h"
+#include "FreeRTOS.h"
 
 // Default configuration
 static const klbn_nrf24l01_config_t default_config = {
@@ -23,12 +24,79 @@ static const klbn_nrf24l01_config_t default_config = {
     .delay = NRF24L01_DEFAULT_DELAY,
     .auto_ack = true,
     .dynamic_payload = false,
-    .payload_size = 32
+    .payload_size = 32,
+    .rx_pipes = 0x01,
+    .ack_payload = false
 };
 
 static bool nrf24l01_initialized = false;
 static klbn_nrf24l01_config_t current_config;
 
+// RAM copy of every single-byte register written or read, and the STATUS
+// byte the chip clocked out on the most recent command
+static uint8_t reg_shadow[NRF24L01_REG_COUNT];
+static uint32_t reg_shadow_valid = 0;
+static uint8_t last_status = 0;
+
+// Configuration registers in write order: FEATURE enables DYNPD, CONFIG
+// powers the chip up once everything else is in place
+static const uint8_t image_order[] = {
+    NRF24L01_REG_SETUP_AW, NRF24L01_REG_EN_AA, NRF24L01_REG_EN_RXADDR,
+    NRF24L01_REG_SETUP_RETR, NRF24L01_REG_RF_CH, NRF24L01_REG_RF_SETUP,
+    NRF24L01_REG_RX_PW_P0, NRF24L01_REG_RX_PW_P1, NRF24L01_REG_RX_PW_P2,
+    NRF24L01_REG_RX_PW_P3, NRF24L01_REG_RX_PW_P4, NRF24L01_REG_RX_PW_P5,
+    NRF24L01_REG_FEATURE, NRF24L01_REG_DYNPD, NRF24L01_REG_CONFIG
+};
+
+#define NRF24L01_IMAGE_REGISTERS \
+    ((1UL << NRF24L01_REG_CONFIG) | (1UL << NRF24L01_REG_EN_AA) | \
+     (1UL << NRF24L01_REG_EN_RXADDR) | (1UL << NRF24L01_REG_SETUP_AW) | \
+     (1UL << NRF24L01_REG_SETUP_RETR) | (1UL << NRF24L01_REG_RF_CH) | \
+     (1UL << NRF24L01_REG_RF_SETUP) | (0x3FUL << NRF24L01_REG_RX_PW_P0) | \
+     (1UL << NRF24L01_REG_DYNPD) | (1UL << NRF24L01_REG_FEATURE))
+
+#define NRF24L01_SHORT_ADDRESS_REGISTERS (0x0FUL << NRF24L01_REG_RX_ADDR_P2)
+
+// 5-byte address registers (TX, pipe 0, pipe 1), their last written values
+// and the byte each one is filled with at power-on
+static const uint8_t address_registers[3] = {
+    NRF24L01_REG_TX_ADDR, NRF24L01_REG_RX_ADDR_P0, NRF24L01_REG_RX_ADDR_P1
+};
+static const uint8_t address_reset[3] = {0xE7, 0xE7, 0xC2};
+static uint8_t address_shadow[3][NRF24L01_ADDRESS_WIDTH] = {
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xC2, 0xC2, 0xC2, 0xC2, 0xC2}
+};
+
+static klbn_nrf24l01_mode_t current_mode = KLBN_NRF24L01_MODE_POWER_DOWN;
+
+// ACK payloads waiting in the TX FIFO while receiving
+static uint8_t ack_in_fifo = 0;
+
+static klbn_nrf24l01_rx_stats_t rx_stats = {0};
+
+// Fixed payload width of each RX pipe
+static uint8_t pipe_payload_size[NRF24L01_PIPE_COUNT];
+
+// Streaming TX queue. Entries stay queued until the chip reports them sent,
+// the first tx_in_fifo entries from tx_head have been written to the chip.
+typedef struct {
+    uint8_t data[NRF24L01_MAX_PAYLOAD_SIZE];
+    uint8_t length;
+    bool no_ack;
+    klbn_nrf24l01_tx_callback_t callback;
+    void *context;
+} nrf24l01_tx_entry_t;
+
+static nrf24l01_tx_entry_t tx_queue[NRF24L01_TX_QUEUE_LENGTH];
+static uint8_t tx_head = 0;
+static uint8_t tx_count = 0;
+static uint8_t tx_in_fifo = 0;
+static bool tx_streaming = false;
+static bool tx_servicing = false;     // Completion callbacks are running
+static klbn_nrf24l01_tx_stats_t tx_stats;
+
 /**
  * @brief Configure NRF24L01 GPIO pins
  */
@@ -43,6 +111,14 @@ static void klbn_nrf24l01_configure_gpio(void) {
     klbn_gpio_clear_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
 }
 
+/**
+ * @brief Check if the chip may change a register on its own
+ */
+static bool klbn_nrf24l01_register_volatile(uint8_t reg) {
+    return reg == NRF24L01_REG_STATUS || reg == NRF24L01_REG_OBSERVE_TX ||
+           reg == NRF24L01_REG_RPD || reg == NRF24L01_REG_FIFO_STATUS;
+}
+
 /**
  * @brief Read register from NRF24L01
  */
@@ -50,49 +126,76 @@ static uint8_t klbn_nrf24l01_read_register(uint8_t reg) {
     uint8_t value;
     
     klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_R_REGISTER | reg);
+    last_status = klbn_spi_transfer(NRF24L01_CMD_R_REGISTER | reg);
     value = klbn_spi_transfer(0xFF);
     klbn_spi_cs_high();
     
+    if (reg < NRF24L01_REG_COUNT && !klbn_nrf24l01_register_volatile(reg)) {
+        reg_shadow[reg] = value;
+        reg_shadow_valid |= (1UL << reg);
+    }
+    
     return value;
 }
 
+/**
+ * @brief Read a register, answering from the shadow copy when it is known
+ */
+static uint8_t klbn_nrf24l01_read_register_cached(uint8_t reg) {
+    if (reg < NRF24L01_REG_COUNT && (reg_shadow_valid & (1UL << reg))) {
+        return reg_shadow[reg];
+    }
+    
+    return klbn_nrf24l01_read_register(reg);
+}
+
 /**
  * @brief Write register to NRF24L01
  */
 static void klbn_nrf24l01_write_register(uint8_t reg, uint8_t value) {
     klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_W_REGISTER | reg);
+    last_status = klbn_spi_transfer(NRF24L01_CMD_W_REGISTER | reg);
     klbn_spi_transfer(value);
     klbn_spi_cs_high();
+    
+    if (reg < NRF24L01_REG_COUNT && !klbn_nrf24l01_register_volatile(reg)) {
+        reg_shadow[reg] = value;
+        reg_shadow_valid |= (1UL << reg);
+    }
 }
 
 /**
  * @brief Read multiple bytes from register
  */
-/*static void klbn_nrf24l01_read_register_multi(uint8_t reg, uint8_t *data, uint8_t length) {
+static void klbn_nrf24l01_read_register_multi(uint8_t reg, uint8_t *data, uint8_t length) {
     klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_R_REGISTER | reg);
-    
-    for (uint8_t i = 0; i < length; i++) {
-        data[i] = klbn_spi_transfer(0xFF);
-    }
-    
+    last_status = klbn_spi_transfer(NRF24L01_CMD_R_REGISTER | reg);
+    klbn_spi_transfer_multi(NULL, data, length);
     klbn_spi_cs_high();
-    }*/
+}
 
 /**
  * @brief Write multiple bytes to register
  */
 static void klbn_nrf24l01_write_register_multi(uint8_t reg, const uint8_t *data, uint8_t length) {
     klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_W_REGISTER | reg);
+    last_status = klbn_spi_transfer(NRF24L01_CMD_W_REGISTER | reg);
+    klbn_spi_transfer_multi(data, NULL, length);
+    klbn_spi_cs_high();
     
-    for (uint8_t i = 0; i < length; i++) {
-        klbn_spi_transfer(data[i]);
+    if (length == 1 && reg < NRF24L01_REG_COUNT) {
+        reg_shadow[reg] = data[0];
+        reg_shadow_valid |= (1UL << reg);
+        return;
     }
     
-    klbn_spi_cs_high();
+    for (uint8_t i = 0; i < 3; i++) {
+        if (reg == address_registers[i] && length == NRF24L01_ADDRESS_WIDTH) {
+            for (uint8_t b = 0; b < NRF24L01_ADDRESS_WIDTH; b++) {
+                address_shadow[i][b] = data[b];
+            }
+        }
+    }
 }
 
 /**
@@ -105,9 +208,318 @@ static uint8_t klbn_nrf24l01_send_command(uint8_t cmd) {
     status = klbn_spi_transfer(cmd);
     klbn_spi_cs_high();
     
+    last_status = status;
     return status;
 }
 
+/**
+ * @brief Write a payload into the TX FIFO
+ */
+static void klbn_nrf24l01_write_payload(const uint8_t *data, uint8_t length, bool no_ack) {
+    klbn_spi_cs_low();
+    last_status = klbn_spi_transfer(no_ack ? NRF24L01_CMD_W_TX_PAYLOAD_NO_ACK
+                                           : NRF24L01_CMD_W_TX_PAYLOAD);
+    klbn_spi_transfer_multi(data, NULL, length);
+    klbn_spi_cs_high();
+}
+
+/**
+ * @brief Move queued payloads into the TX FIFO until it is full
+ *
+ * tx_in_fifo never undercounts the chip's FIFO, so this cannot overflow it.
+ */
+static void klbn_nrf24l01_stream_fill(void) {
+    while (tx_in_fifo < tx_count && tx_in_fifo < NRF24L01_TX_FIFO_DEPTH) {
+        const nrf24l01_tx_entry_t *entry =
+            &tx_queue[(tx_head + tx_in_fifo) % NRF24L01_TX_QUEUE_LENGTH];
+        klbn_nrf24l01_write_payload(entry->data, entry->length, entry->no_ack);
+        tx_in_fifo++;
+    }
+}
+
+/**
+ * @brief Append a payload to the TX queue (caller checks for room)
+ */
+static void klbn_nrf24l01_stream_push(const uint8_t *data, uint8_t length, bool no_ack,
+                                      klbn_nrf24l01_tx_callback_t callback, void *context) {
+    nrf24l01_tx_entry_t *entry = &tx_queue[(tx_head + tx_count) % NRF24L01_TX_QUEUE_LENGTH];
+    for (uint8_t i = 0; i < length; i++) {
+        entry->data[i] = data[i];
+    }
+    entry->length = length;
+    entry->no_ack = no_ack;
+    entry->callback = callback;
+    entry->context = context;
+    tx_count++;
+}
+
+/**
+ * @brief Get newly queued payloads on air
+ */
+static void klbn_nrf24l01_stream_start(void) {
+    if (tx_streaming) {
+        // Already in TX mode with CE high, a free FIFO slot sends at once.
+        // From a completion callback the refill is left to the service pass.
+        if (!tx_servicing) {
+            klbn_nrf24l01_stream_fill();
+        }
+        return;
+    }
+    
+    // Load the FIFO in standby, then raise CE and keep it high
+    klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_STANDBY);
+    klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_TX);
+    klbn_nrf24l01_clear_status(NRF24L01_STATUS_TX_DS | NRF24L01_STATUS_MAX_RT);
+    tx_in_fifo = 0;
+    ack_in_fifo = 0;
+    klbn_nrf24l01_stream_fill();
+    
+    tx_streaming = true;
+    klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_TX);
+}
+
+/**
+ * @brief Retire entries from the head of the TX queue and run callbacks
+ * @param last_retransmits ARC of the last retired entry (earlier ones are
+ *                         reported as NRF24L01_ARC_UNKNOWN)
+ */
+static void klbn_nrf24l01_stream_pop(uint8_t count, klbn_nrf24l01_error_t result,
+                                     uint8_t last_retransmits) {
+    while (count--) {
+        nrf24l01_tx_entry_t *entry = &tx_queue[tx_head];
+        
+        tx_head = (tx_head + 1) % NRF24L01_TX_QUEUE_LENGTH;
+        tx_count--;
+        tx_in_fifo--;
+        
+        if (entry->callback != NULL) {
+            entry->callback(result, (count == 0) ? last_retransmits : NRF24L01_ARC_UNKNOWN,
+                            entry->context);
+        }
+    }
+}
+
+/**
+ * @brief Check if any of the first count in-flight entries has a callback
+ */
+static bool klbn_nrf24l01_stream_wants_result(uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (tx_queue[(tx_head + i) % NRF24L01_TX_QUEUE_LENGTH].callback != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Count payloads left in a halted TX FIFO
+ *
+ * FIFO_STATUS only flags empty and full, so pad the FIFO with throwaway
+ * payloads until it reports full. Only valid while MAX_RT is pending (the
+ * chip is not transmitting), and the FIFO must be flushed afterwards.
+ */
+static uint8_t klbn_nrf24l01_count_halted_tx_fifo(void) {
+    uint8_t padding = 0;
+    uint8_t pad_byte = 0;
+    
+    while (padding < NRF24L01_TX_FIFO_DEPTH &&
+           !(klbn_nrf24l01_read_register(NRF24L01_REG_FIFO_STATUS) & NRF24L01_FIFO_STATUS_TX_FULL)) {
+        klbn_nrf24l01_write_payload(&pad_byte, 1, false);
+        padding++;
+    }
+    
+    return NRF24L01_TX_FIFO_DEPTH - padding;
+}
+
+/**
+ * @brief Read the payload at the head of the RX FIFO
+ * @return false if the width was corrupt and the FIFO was flushed
+ */
+static bool klbn_nrf24l01_read_rx_payload(uint8_t rx_pipe, uint8_t *data, uint8_t *length) {
+    // Get payload width
+    uint8_t payload_width;
+    if (current_config.dynamic_payload) {
+        klbn_spi_cs_low();
+        last_status = klbn_spi_transfer(NRF24L01_CMD_R_RX_PL_WID);
+        payload_width = klbn_spi_transfer(0xFF);
+        klbn_spi_cs_high();
+        
+        if (payload_width > NRF24L01_MAX_PAYLOAD_SIZE) {
+            // Invalid payload width, flush RX FIFO
+            klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_RX);
+            return false;
+        }
+    } else {
+        payload_width = pipe_payload_size[rx_pipe];
+    }
+    
+    // Read payload
+    klbn_spi_cs_low();
+    last_status = klbn_spi_transfer(NRF24L01_CMD_R_RX_PAYLOAD);
+    klbn_spi_transfer_multi(NULL, data, payload_width);
+    klbn_spi_cs_high();
+    
+    *length = payload_width;
+    rx_stats.received++;
+    
+    return true;
+}
+
+/**
+ * @brief RF_SETUP value for a data rate and power level
+ */
+static uint8_t klbn_nrf24l01_rf_setup_value(klbn_nrf24l01_datarate_t datarate,
+                                            klbn_nrf24l01_power_t power) {
+    // Power level (RF_PWR bits 2:1) and data rate
+    uint8_t rf_setup = ((uint8_t)power << 1) & NRF24L01_RF_SETUP_RF_PWR;
+    switch (datarate) {
+        case KLBN_NRF24L01_DATARATE_250KBPS:
+            rf_setup |= NRF24L01_RF_SETUP_RF_DR_LOW;
+            break;
+        case KLBN_NRF24L01_DATARATE_1MBPS:
+            // Default, no bits set
+            break;
+        case KLBN_NRF24L01_DATARATE_2MBPS:
+            rf_setup |= NRF24L01_RF_SETUP_RF_DR_HIGH;
+            break;
+    }
+    return rf_setup;
+}
+
+/**
+ * @brief Compile a configuration into register values
+ */
+static void klbn_nrf24l01_build_image(const klbn_nrf24l01_config_t *config, uint8_t *image) {
+    for (uint8_t reg = 0; reg < NRF24L01_REG_COUNT; reg++) {
+        image[reg] = 0;
+    }
+    
+    // Auto acknowledgment on every pipe, the requested RX pipes, 5-byte addresses
+    image[NRF24L01_REG_EN_AA] = config->auto_ack ? NRF24L01_PIPE_ALL : 0x00;
+    image[NRF24L01_REG_EN_RXADDR] = config->rx_pipes & NRF24L01_PIPE_ALL;
+    image[NRF24L01_REG_SETUP_AW] = 0x03;
+    
+    // Auto retransmit and RF channel
+    image[NRF24L01_REG_SETUP_RETR] = (config->delay << 4) | (config->retries & 0x0F);
+    image[NRF24L01_REG_RF_CH] = config->channel & 0x7F;
+    
+    image[NRF24L01_REG_RF_SETUP] = klbn_nrf24l01_rf_setup_value(config->datarate, config->power);
+    
+    for (uint8_t pipe = 0; pipe < NRF24L01_PIPE_COUNT; pipe++) {
+        image[NRF24L01_REG_RX_PW_P0 + pipe] = config->payload_size;
+    }
+    
+    if (config->dynamic_payload || config->ack_payload) {
+        image[NRF24L01_REG_FEATURE] = NRF24L01_FEATURE_EN_DPL;
+        image[NRF24L01_REG_DYNPD] = NRF24L01_PIPE_ALL;
+    }
+    
+    // Allow per-payload NO_ACK for broadcasts
+    image[NRF24L01_REG_FEATURE] |= NRF24L01_FEATURE_EN_DYN_ACK;
+    
+    // ACK payloads have no fixed width, so they ride on dynamic payloads
+    if (config->ack_payload) {
+        image[NRF24L01_REG_FEATURE] |= NRF24L01_FEATURE_EN_ACK_PAY;
+    }
+    
+    // Powered up in standby mode
+    image[NRF24L01_REG_CONFIG] = NRF24L01_CONFIG_EN_CRC | NRF24L01_CONFIG_CRCO | NRF24L01_CONFIG_PWR_UP;
+}
+
+/**
+ * @brief Write the registers of an image that differ from the known chip state
+ *
+ * The nRF24L01 has no auto-increment across registers, so each register is
+ * its own transaction; registers already holding the value are skipped.
+ */
+static void klbn_nrf24l01_apply_image(const uint8_t *image) {
+    for (uint8_t i = 0; i < sizeof(image_order); i++) {
+        uint8_t reg = image_order[i];
+        
+        if ((reg_shadow_valid & (1UL << reg)) && reg_shadow[reg] == image[reg]) {
+            continue;
+        }
+        klbn_nrf24l01_write_register(reg, image[reg]);
+    }
+}
+
+/**
+ * @brief Write back pipe and TX addresses that differ from the known state
+ */
+static void klbn_nrf24l01_apply_addresses(void) {
+    for (uint8_t i = 0; i < 3; i++) {
+        bool differs = false;
+        for (uint8_t b = 0; b < NRF24L01_ADDRESS_WIDTH; b++) {
+            differs |= (address_shadow[i][b] != address_reset[i]);
+        }
+        if (differs) {
+            klbn_nrf24l01_write_register_multi(address_registers[i], address_shadow[i],
+                                               NRF24L01_ADDRESS_WIDTH);
+        }
+    }
+}
+
+/**
+ * @brief Write all pipe and TX addresses from the shadow
+ *
+ * After a warm MCU reset the radio may still be powered and hold the
+ * addresses set before the reset, so init cannot assume power-on values.
+ */
+static void klbn_nrf24l01_write_addresses(void) {
+    for (uint8_t i = 0; i < 3; i++) {
+        klbn_nrf24l01_write_register_multi(address_registers[i], address_shadow[i],
+                                           NRF24L01_ADDRESS_WIDTH);
+    }
+}
+
+/**
+ * @brief Assume the chip is at its power-on register values
+ */
+static void klbn_nrf24l01_load_reset_shadow(void) {
+    for (uint8_t reg = 0; reg < NRF24L01_REG_COUNT; reg++) {
+        reg_shadow[reg] = 0x00;
+    }
+    reg_shadow[NRF24L01_REG_CONFIG] = 0x08;
+    reg_shadow[NRF24L01_REG_EN_AA] = 0x3F;
+    reg_shadow[NRF24L01_REG_EN_RXADDR] = 0x03;
+    reg_shadow[NRF24L01_REG_SETUP_AW] = 0x03;
+    reg_shadow[NRF24L01_REG_SETUP_RETR] = 0x03;
+    reg_shadow[NRF24L01_REG_RF_CH] = 0x02;
+    reg_shadow[NRF24L01_REG_RF_SETUP] = 0x0E;
+    reg_shadow[NRF24L01_REG_RX_ADDR_P2] = 0xC3;
+    reg_shadow[NRF24L01_REG_RX_ADDR_P3] = 0xC4;
+    reg_shadow[NRF24L01_REG_RX_ADDR_P4] = 0xC5;
+    reg_shadow[NRF24L01_REG_RX_ADDR_P5] = 0xC6;
+    reg_shadow_valid = NRF24L01_IMAGE_REGISTERS | NRF24L01_SHORT_ADDRESS_REGISTERS;
+}
+
+/**
+ * @brief Read the configuration back and compare it with the shadow
+ */
+static bool klbn_nrf24l01_verify_image(void) {
+    for (uint8_t i = 0; i < sizeof(image_order); i++) {
+        uint8_t reg = image_order[i];
+        uint8_t expected = reg_shadow[reg];
+        
+        if (klbn_nrf24l01_read_register(reg) != expected) {
+            return false;
+        }
+    }
+    
+    // Address registers in one burst each
+    uint8_t address[NRF24L01_ADDRESS_WIDTH];
+    for (uint8_t i = 0; i < 3; i++) {
+        klbn_nrf24l01_read_register_multi(address_registers[i], address, NRF24L01_ADDRESS_WIDTH);
+        for (uint8_t b = 0; b < NRF24L01_ADDRESS_WIDTH; b++) {
+            if (address[b] != address_shadow[i][b]) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
 klbn_nrf24l01_error_t klbn_nrf24l01_init(const klbn_nrf24l01_config_t *config) {
     // Use default config if none provided
     if (config == NULL) {
@@ -116,6 +528,12 @@ klbn_nrf24l01_error_t klbn_nrf24l01_init(const klbn_nrf24l01_config_t *config) {
     
     // Store current config
     current_config = *config;
+    if (config->ack_payload) {
+        current_config.dynamic_payload = true;
+    }
+    
+    // Chip state is unknown until written
+    reg_shadow_valid = 0;
     
     // Initialize SPI if not already done
     if (klbn_spi_init(NULL) != KLBN_SPI_OK) {
@@ -125,92 +543,115 @@ klbn_nrf24l01_error_t klbn_nrf24l01_init(const klbn_nrf24l01_config_t *config) {
     // Configure GPIO pins
     klbn_nrf24l01_configure_gpio();
     
-    // Power down mode
+    // Power down mode (registers stay writable over SPI)
     klbn_nrf24l01_write_register(NRF24L01_REG_CONFIG, 0x00);
-    klbn_delay_ms(2);
     
     // Test if NRF24L01 is present
     if (!klbn_nrf24l01_test()) {
         return KLBN_NRF24L01_ERROR_NOT_FOUND;
     }
     
-    // Configure auto acknowledgment
-    uint8_t en_aa = config->auto_ack ? 0x01 : 0x00;
-    klbn_nrf24l01_write_register(NRF24L01_REG_EN_AA, en_aa);
+    for (uint8_t pipe = 0; pipe < NRF24L01_PIPE_COUNT; pipe++) {
+        pipe_payload_size[pipe] = config->payload_size;
+    }
     
-    // Enable RX pipe 0
-    klbn_nrf24l01_write_register(NRF24L01_REG_EN_RXADDR, 0x01);
+    // Write the whole configuration, powering up in standby mode last
+    uint8_t image[NRF24L01_REG_COUNT];
+    klbn_nrf24l01_build_image(config, image);
+    klbn_nrf24l01_apply_image(image);
+    klbn_nrf24l01_write_addresses();
     
-    // Set address width to 5 bytes
-    klbn_nrf24l01_write_register(NRF24L01_REG_SETUP_AW, 0x03);
+    // Clear status flags
+    klbn_nrf24l01_clear_status(NRF24L01_STATUS_RX_DR | NRF24L01_STATUS_TX_DS | NRF24L01_STATUS_MAX_RT);
     
-    // Set auto retransmit
-    uint8_t setup_retr = (config->delay << 4) | (config->retries & 0x0F);
-    klbn_nrf24l01_write_register(NRF24L01_REG_SETUP_RETR, setup_retr);
+    // Flush TX and RX FIFOs
+    klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_TX);
+    klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_RX);
     
-    // Set RF channel
-    klbn_nrf24l01_write_register(NRF24L01_REG_RF_CH, config->channel & 0x7F);
+    if (!klbn_nrf24l01_verify_image()) {
+        return KLBN_NRF24L01_ERROR_NOT_FOUND;
+    }
     
-    // Set RF setup (power and data rate)
-    uint8_t rf_setup = 0;
+    // CE must stay low until the crystal is up after PWR_UP (Tpd2stby)
+    klbn_delay_us(NRF24L01_TPD2STBY_US);
     
-    // Set power level
-    switch (config->power) {
-        case KLBN_NRF24L01_POWER_M18DBM:
-            rf_setup |= 0x00;
-            break;
-        case KLBN_NRF24L01_POWER_M12DBM:
-            rf_setup |= 0x02;
-            break;
-        case KLBN_NRF24L01_POWER_M6DBM:
-            rf_setup |= 0x04;
-            break;
-        case KLBN_NRF24L01_POWER_0DBM:
-            rf_setup |= 0x06;
-            break;
+    current_mode = KLBN_NRF24L01_MODE_STANDBY;
+    nrf24l01_initialized = true;
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_reinit(void) {
+    if (!nrf24l01_initialized) {
+        return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
     }
     
-    // Set data rate
-    switch (config->datarate) {
-        case KLBN_NRF24L01_DATARATE_250KBPS:
-            rf_setup |= NRF24L01_RF_SETUP_RF_DR_LOW;
-            break;
-        case KLBN_NRF24L01_DATARATE_1MBPS:
-            // Default, no bits set
-            break;
-        case KLBN_NRF24L01_DATARATE_2MBPS:
-            rf_setup |= NRF24L01_RF_SETUP_RF_DR_HIGH;
-            break;
+    klbn_gpio_clear_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+    
+    // The shadow holds the state to restore, and after a brownout the chip
+    // is back at its power-on values: only registers that differ are written
+    if ((reg_shadow_valid & NRF24L01_IMAGE_REGISTERS) != NRF24L01_IMAGE_REGISTERS) {
+        return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
     }
     
-    klbn_nrf24l01_write_register(NRF24L01_REG_RF_SETUP, rf_setup);
+    uint8_t image[NRF24L01_REG_COUNT];
+    for (uint8_t reg = 0; reg < NRF24L01_REG_COUNT; reg++) {
+        image[reg] = reg_shadow[reg];
+    }
+    uint32_t image_valid = reg_shadow_valid;
+    
+    klbn_nrf24l01_load_reset_shadow();
     
-    // Set payload size for pipe 0
-    klbn_nrf24l01_write_register(NRF24L01_REG_RX_PW_P0, config->payload_size);
+    // Restore the configured mode last, keeping CONFIG out of the image pass
+    uint8_t config = image[NRF24L01_REG_CONFIG];
+    image[NRF24L01_REG_CONFIG] = reg_shadow[NRF24L01_REG_CONFIG];
+    klbn_nrf24l01_apply_image(image);
+    klbn_nrf24l01_apply_addresses();
     
-    // Configure dynamic payload if enabled
-    if (config->dynamic_payload) {
-        klbn_nrf24l01_write_register(NRF24L01_REG_FEATURE, 0x04);
-        klbn_nrf24l01_write_register(NRF24L01_REG_DYNPD, 0x01);
+    // Pipes 2-5 only hold the low address byte
+    for (uint8_t reg = NRF24L01_REG_RX_ADDR_P2; reg <= NRF24L01_REG_RX_ADDR_P5; reg++) {
+        if ((image_valid & (1UL << reg)) && image[reg] != reg_shadow[reg]) {
+            klbn_nrf24l01_write_register(reg, image[reg]);
+        }
     }
     
-    // Clear status flags
     klbn_nrf24l01_clear_status(NRF24L01_STATUS_RX_DR | NRF24L01_STATUS_TX_DS | NRF24L01_STATUS_MAX_RT);
     
-    // Flush TX and RX FIFOs
-    klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_TX);
-    klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_RX);
+    // Whatever was in the TX FIFO is gone, rewrite it from the queue
+    tx_in_fifo = 0;
+    ack_in_fifo = 0;
+    klbn_nrf24l01_stream_fill();
+    
+    klbn_nrf24l01_write_register(NRF24L01_REG_CONFIG, config);
+    if (!klbn_nrf24l01_verify_image()) {
+        return KLBN_NRF24L01_ERROR_NOT_FOUND;
+    }
     
-    // Power up in standby mode
-    klbn_nrf24l01_write_register(NRF24L01_REG_CONFIG, 
-        NRF24L01_CONFIG_EN_CRC | NRF24L01_CONFIG_CRCO | NRF24L01_CONFIG_PWR_UP);
+    // After a brownout the chip was powered down: wait out Tpd2stby
+    // before CE goes high again
+    klbn_delay_us(NRF24L01_TPD2STBY_US);
     
-    klbn_delay_ms(2);
+    if (current_mode == KLBN_NRF24L01_MODE_TX || current_mode == KLBN_NRF24L01_MODE_RX) {
+        klbn_gpio_set_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+    }
     
-    nrf24l01_initialized = true;
     return KLBN_NRF24L01_OK;
 }
 
+bool klbn_nrf24l01_config_intact(void) {
+    if (!nrf24l01_initialized || !(reg_shadow_valid & (1UL << NRF24L01_REG_CONFIG))) {
+        return false;
+    }
+    
+    // A brownout resets CONFIG, which is never 0x08 while we run
+    uint8_t expected = reg_shadow[NRF24L01_REG_CONFIG];
+    klbn_spi_cs_low();
+    last_status = klbn_spi_transfer(NRF24L01_CMD_R_REGISTER | NRF24L01_REG_CONFIG);
+    uint8_t value = klbn_spi_transfer(0xFF);
+    klbn_spi_cs_high();
+    
+    return value == expected;
+}
+
 klbn_nrf24l01_error_t klbn_nrf24l01_deinit(void) {
     if (!nrf24l01_initialized) {
         return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
@@ -229,7 +670,8 @@ klbn_nrf24l01_error_t klbn_nrf24l01_set_mode(klbn_nrf24l01_mode_t mode) {
         return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
     }
     
-    uint8_t config = klbn_nrf24l01_read_register(NRF24L01_REG_CONFIG);
+    uint8_t previous = klbn_nrf24l01_read_register_cached(NRF24L01_REG_CONFIG);
+    uint8_t config = previous;
     
     switch (mode) {
         case KLBN_NRF24L01_MODE_POWER_DOWN:
@@ -255,12 +697,97 @@ klbn_nrf24l01_error_t klbn_nrf24l01_set_mode(klbn_nrf24l01_mode_t mode) {
             break;
     }
     
-    klbn_nrf24l01_write_register(NRF24L01_REG_CONFIG, config);
+    if (config != previous) {
+        klbn_nrf24l01_write_register(NRF24L01_REG_CONFIG, config);
+    }
+    current_mode = mode;
     klbn_delay_us(130); // Mode change delay
     
     return KLBN_NRF24L01_OK;
 }
 
+klbn_nrf24l01_error_t klbn_nrf24l01_set_rf(klbn_nrf24l01_datarate_t datarate,
+                                           klbn_nrf24l01_power_t power) {
+    if (!nrf24l01_initialized) {
+        return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
+    }
+    
+    if (datarate > KLBN_NRF24L01_DATARATE_2MBPS || power > KLBN_NRF24L01_POWER_0DBM) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    // Takes effect from the next packet, no mode change needed
+    uint8_t rf_setup = klbn_nrf24l01_rf_setup_value(datarate, power);
+    if (klbn_nrf24l01_read_register_cached(NRF24L01_REG_RF_SETUP) != rf_setup) {
+        klbn_nrf24l01_write_register(NRF24L01_REG_RF_SETUP, rf_setup);
+    }
+    
+    current_config.datarate = datarate;
+    current_config.power = power;
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_set_channel(uint8_t channel) {
+    if (!nrf24l01_initialized) {
+        return KLBN_NRF24L01_ERROR_NOT_INITIALIZED;
+    }
+    
+    if (channel > NRF24L01_MAX_CHANNEL) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    if (klbn_nrf24l01_read_register_cached(NRF24L01_REG_RF_CH) != channel) {
+        // The synthesizer only retunes on the way out of standby
+        bool listening = (current_mode == KLBN_NRF24L01_MODE_RX);
+        if (listening) {
+            klbn_gpio_clear_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+        }
+        klbn_nrf24l01_write_register(NRF24L01_REG_RF_CH, channel);
+        if (listening) {
+            klbn_gpio_set_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+        }
+    }
+    
+    current_config.channel = channel;
+    return KLBN_NRF24L01_OK;
+}
+
+uint8_t klbn_nrf24l01_get_channel(void) {
+    return current_config.channel;
+}
+
+uint8_t klbn_nrf24l01_sample_carrier(uint8_t channel, uint8_t samples) {
+    if (!nrf24l01_initialized || tx_streaming || channel > NRF24L01_MAX_CHANNEL) {
+        return 0;
+    }
+    
+    klbn_nrf24l01_mode_t mode = current_mode;
+    uint8_t previous_channel = current_config.channel;
+    uint8_t hits = 0;
+    
+    // PRIM_RX set, CE pulsed per sample below
+    klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_RX);
+    klbn_nrf24l01_set_channel(channel);
+    klbn_gpio_clear_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+    
+    for (uint8_t i = 0; i < samples; i++) {
+        // RPD needs the receiver settled (130 us) plus 40 us of dwell, and
+        // latches its result when CE drops
+        klbn_gpio_set_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+        klbn_delay_us(NRF24L01_RPD_DWELL_US);
+        klbn_gpio_clear_pin((uint32_t)KLBN_NRF24L01_CE_PORT, KLBN_NRF24L01_CE_PIN);
+        
+        if (klbn_nrf24l01_read_register(NRF24L01_REG_RPD) & 0x01) {
+            hits++;
+        }
+    }
+    
+    klbn_nrf24l01_set_channel(previous_channel);
+    klbn_nrf24l01_set_mode(mode);
+    
+    return hits;
+}
+
 klbn_nrf24l01_error_t klbn_nrf24l01_set_tx_address(const uint8_t *address) {
     if (!nrf24l01_initialized || address == NULL) {
         return KLBN_NRF24L01_ERROR_INVALID_PARAM;
@@ -277,11 +804,45 @@ klbn_nrf24l01_error_t klbn_nrf24l01_set_tx_address(const uint8_t *address) {
 }
 
 klbn_nrf24l01_error_t klbn_nrf24l01_set_rx_address(const uint8_t *address) {
-    if (!nrf24l01_initialized || address == NULL) {
+    return klbn_nrf24l01_set_pipe_address(0, address);
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_set_pipe_address(uint8_t pipe, const uint8_t *address) {
+    if (!nrf24l01_initialized || address == NULL || pipe >= NRF24L01_PIPE_COUNT) {
         return KLBN_NRF24L01_ERROR_INVALID_PARAM;
     }
     
-    klbn_nrf24l01_write_register_multi(NRF24L01_REG_RX_ADDR_P0, address, NRF24L01_ADDRESS_WIDTH);
+    // Pipes 2-5 only hold the LSB, the rest is shared with pipe 1
+    uint8_t width = (pipe < 2) ? NRF24L01_ADDRESS_WIDTH : 1;
+    klbn_nrf24l01_write_register_multi(NRF24L01_REG_RX_ADDR_P0 + pipe, address, width);
+    
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_set_pipe_payload_size(uint8_t pipe, uint8_t size) {
+    if (!nrf24l01_initialized || pipe >= NRF24L01_PIPE_COUNT ||
+        size == 0 || size > NRF24L01_MAX_PAYLOAD_SIZE) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    pipe_payload_size[pipe] = size;
+    klbn_nrf24l01_write_register(NRF24L01_REG_RX_PW_P0 + pipe, size);
+    
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_enable_pipe(uint8_t pipe, bool enable) {
+    if (!nrf24l01_initialized || pipe >= NRF24L01_PIPE_COUNT) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    uint8_t en_rxaddr = klbn_nrf24l01_read_register_cached(NRF24L01_REG_EN_RXADDR);
+    if (enable) {
+        en_rxaddr |= (1 << pipe);
+    } else {
+        en_rxaddr &= ~(1 << pipe);
+    }
+    klbn_nrf24l01_write_register(NRF24L01_REG_EN_RXADDR, en_rxaddr);
     
     return KLBN_NRF24L01_OK;
 }
@@ -291,19 +852,20 @@ klbn_nrf24l01_error_t klbn_nrf24l01_transmit(const uint8_t *data, uint8_t length
         return KLBN_NRF24L01_ERROR_INVALID_PARAM;
     }
     
+    // The TX FIFO belongs to the streaming path until it drains
+    if (tx_streaming) {
+        return KLBN_NRF24L01_ERROR_BUSY;
+    }
+    
     // Set to standby mode
     klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_STANDBY);
     
-    // Clear TX FIFO
+    // Clear TX FIFO, including uncollected ACK payloads
     klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_TX);
+    ack_in_fifo = 0;
     
     // Write payload
-    klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_W_TX_PAYLOAD);
-    for (uint8_t i = 0; i < length; i++) {
-        klbn_spi_transfer(data[i]);
-    }
-    klbn_spi_cs_high();
+    klbn_nrf24l01_write_payload(data, length, false);
     
     // Enter TX mode
     klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_TX);
@@ -325,66 +887,280 @@ klbn_nrf24l01_error_t klbn_nrf24l01_transmit(const uint8_t *data, uint8_t length
     // Check if transmission was successful
     uint8_t status = klbn_nrf24l01_get_status();
     if (status & NRF24L01_STATUS_MAX_RT) {
+        // The failed payload stays in the FIFO, the next transmit flushes it
         klbn_nrf24l01_clear_status(NRF24L01_STATUS_MAX_RT);
+        tx_stats.failed++;
         return KLBN_NRF24L01_ERROR_TX_FAILED;
     }
     
     // Clear TX_DS flag
     klbn_nrf24l01_clear_status(NRF24L01_STATUS_TX_DS);
+    tx_stats.sent++;
     
     return KLBN_NRF24L01_OK;
 }
 
-klbn_nrf24l01_error_t klbn_nrf24l01_receive(uint8_t *data, uint8_t *length) {
-    if (!nrf24l01_initialized || data == NULL || length == NULL) {
+klbn_nrf24l01_error_t klbn_nrf24l01_stream_write(const uint8_t *data, uint8_t length) {
+    return klbn_nrf24l01_transmit_async(data, length, NULL, NULL);
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_transmit_async(const uint8_t *data, uint8_t length,
+                                                   klbn_nrf24l01_tx_callback_t callback,
+                                                   void *context) {
+    if (!nrf24l01_initialized || data == NULL || length == 0 || length > NRF24L01_MAX_PAYLOAD_SIZE) {
         return KLBN_NRF24L01_ERROR_INVALID_PARAM;
     }
     
-    // Check if data is available
-    if (!klbn_nrf24l01_data_available()) {
-        return KLBN_NRF24L01_ERROR_RX_EMPTY;
+    if (tx_count >= NRF24L01_TX_QUEUE_LENGTH) {
+        return KLBN_NRF24L01_ERROR_BUSY;
     }
     
-    // Get payload width
-    uint8_t payload_width;
-    if (current_config.dynamic_payload) {
-        klbn_spi_cs_low();
-        klbn_spi_transfer(NRF24L01_CMD_R_RX_PL_WID);
-        payload_width = klbn_spi_transfer(0xFF);
-        klbn_spi_cs_high();
+    klbn_nrf24l01_stream_push(data, length, false, callback, context);
+    klbn_nrf24l01_stream_start();
+    
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_broadcast(const uint8_t *data, uint8_t length,
+                                              uint8_t repeats) {
+    if (!nrf24l01_initialized || data == NULL || length == 0 || length > NRF24L01_MAX_PAYLOAD_SIZE) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    // All copies or none, so listeners never see a partial burst
+    if ((uint16_t)tx_count + repeats + 1 > NRF24L01_TX_QUEUE_LENGTH) {
+        return KLBN_NRF24L01_ERROR_BUSY;
+    }
+    
+    for (uint8_t i = 0; i <= repeats; i++) {
+        klbn_nrf24l01_stream_push(data, length, true, NULL, NULL);
+    }
+    klbn_nrf24l01_stream_start();
+    
+    return KLBN_NRF24L01_OK;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_write_ack_payload(uint8_t pipe, const uint8_t *data,
+                                                      uint8_t length) {
+    if (!nrf24l01_initialized || !current_config.ack_payload || pipe >= NRF24L01_PIPE_COUNT ||
+        data == NULL || length == 0 || length > NRF24L01_MAX_PAYLOAD_SIZE) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
+    
+    // The TX FIFO holds either outgoing payloads or ACK payloads
+    if (tx_streaming || ack_in_fifo >= NRF24L01_TX_FIFO_DEPTH) {
+        return KLBN_NRF24L01_ERROR_BUSY;
+    }
+    
+    klbn_spi_cs_low();
+    last_status = klbn_spi_transfer(NRF24L01_CMD_W_ACK_PAYLOAD | pipe);
+    klbn_spi_transfer_multi(data, NULL, length);
+    klbn_spi_cs_high();
+    ack_in_fifo++;
+    
+    return KLBN_NRF24L01_OK;
+}
+
+bool klbn_nrf24l01_stream_idle(void) {
+    return !tx_streaming;
+}
+
+void klbn_nrf24l01_get_tx_stats(klbn_nrf24l01_tx_stats_t *stats) {
+    if (stats != NULL) {
+        *stats = tx_stats;
+    }
+}
+
+uint8_t klbn_nrf24l01_service(void) {
+    if (!nrf24l01_initialized) {
+        return 0;
+    }
+    
+    uint8_t status = klbn_nrf24l01_get_status();
+    
+    if (!tx_streaming && (status & NRF24L01_STATUS_TX_DS)) {
+        // A receiver raises TX_DS when an ACK payload went out. Clear it,
+        // or the IRQ line stays low and no further edge is seen.
+        klbn_nrf24l01_clear_status(NRF24L01_STATUS_TX_DS);
+        uint8_t fifo = klbn_nrf24l01_read_register(NRF24L01_REG_FIFO_STATUS);
+        if (fifo & NRF24L01_FIFO_STATUS_TX_EMPTY) {
+            ack_in_fifo = 0;
+        } else if (ack_in_fifo > 0) {
+            ack_in_fifo--;
+        }
+        return status;
+    }
+    
+    if (!tx_streaming && (status & NRF24L01_STATUS_MAX_RT)) {
+        // Left over from an aborted blocking transmit; it would hold IRQ low
+        klbn_nrf24l01_clear_status(NRF24L01_STATUS_MAX_RT);
+        return status;
+    }
+    
+    if (!tx_streaming || !(status & (NRF24L01_STATUS_TX_DS | NRF24L01_STATUS_MAX_RT))) {
+        return status;
+    }
+    
+    uint8_t remaining;
+    tx_servicing = true;
+    
+    if (status & NRF24L01_STATUS_MAX_RT) {
+        // The head payload ran out of retries and halted the chip. Everything
+        // written before it went out, so count what is left and drop the head.
+        remaining = klbn_nrf24l01_count_halted_tx_fifo();
+        klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_TX);
+        klbn_nrf24l01_clear_status(NRF24L01_STATUS_TX_DS | NRF24L01_STATUS_MAX_RT);
         
-        if (payload_width > NRF24L01_MAX_PAYLOAD_SIZE) {
-            // Invalid payload width, flush RX FIFO
-            klbn_nrf24l01_send_command(NRF24L01_CMD_FLUSH_RX);
-            return KLBN_NRF24L01_ERROR_RX_EMPTY;
+        if (remaining > tx_in_fifo) {
+            remaining = tx_in_fifo;
         }
+        tx_stats.sent += tx_in_fifo - remaining;
+        klbn_nrf24l01_stream_pop(tx_in_fifo - remaining, KLBN_NRF24L01_OK,
+                                 NRF24L01_ARC_UNKNOWN);
+        
+        if (tx_in_fifo > 0) {
+            tx_stats.failed++;
+            klbn_nrf24l01_stream_pop(1, KLBN_NRF24L01_ERROR_TX_FAILED,
+                                     current_config.retries);
+        }
+        
+        // The rest was flushed with the failed payload and gets rewritten
+        tx_in_fifo = 0;
     } else {
-        payload_width = current_config.payload_size;
+        // Clear TX_DS before sampling the FIFO: a payload completing in
+        // between still shows up in FIFO_STATUS, and later ones raise IRQ again
+        klbn_nrf24l01_clear_status(NRF24L01_STATUS_TX_DS);
+        uint8_t fifo = klbn_nrf24l01_read_register(NRF24L01_REG_FIFO_STATUS);
+        
+        if (fifo & NRF24L01_FIFO_STATUS_TX_EMPTY) {
+            remaining = 0;
+        } else if (fifo & NRF24L01_FIFO_STATUS_TX_FULL) {
+            remaining = NRF24L01_TX_FIFO_DEPTH;
+        } else {
+            // TX_DS interrupts coalesce, so only one completion is certain.
+            // The next empty or full reading settles the count.
+            remaining = (tx_in_fifo > 1) ? tx_in_fifo - 1 : tx_in_fifo;
+        }
+        
+        if (remaining > tx_in_fifo) {
+            remaining = tx_in_fifo;
+        }
+        
+        // ARC_CNT restarts with every payload, so it only belongs to the last
+        // completed one while nothing newer is on air
+        uint8_t completed = tx_in_fifo - remaining;
+        uint8_t retransmits = NRF24L01_ARC_UNKNOWN;
+        if (remaining == 0 && klbn_nrf24l01_stream_wants_result(completed)) {
+            retransmits = klbn_nrf24l01_read_register(NRF24L01_REG_OBSERVE_TX) & 0x0F;
+        }
+        
+        tx_stats.sent += completed;
+        klbn_nrf24l01_stream_pop(completed, KLBN_NRF24L01_OK, retransmits);
     }
     
-    // Read payload
-    klbn_spi_cs_low();
-    klbn_spi_transfer(NRF24L01_CMD_R_RX_PAYLOAD);
-    for (uint8_t i = 0; i < payload_width; i++) {
-        data[i] = klbn_spi_transfer(0xFF);
+    tx_servicing = false;
+    klbn_nrf24l01_stream_fill();
+    
+    if (tx_count == 0) {
+        // Queue drained, go back to listening
+        tx_streaming = false;
+        klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_RX);
     }
-    klbn_spi_cs_high();
     
-    *length = payload_width;
+    return status;
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_receive(uint8_t *data, uint8_t *length) {
+    return klbn_nrf24l01_receive_pipe(data, length, NULL);
+}
+
+klbn_nrf24l01_error_t klbn_nrf24l01_receive_pipe(uint8_t *data, uint8_t *length, uint8_t *pipe) {
+    if (!nrf24l01_initialized || data == NULL || length == NULL) {
+        return KLBN_NRF24L01_ERROR_INVALID_PARAM;
+    }
     
-    // Clear RX_DR flag
+    // Clear RX_DR up front: the STATUS byte clocked out by the same write
+    // tells which pipe is at the head of the RX FIFO, so no separate NOP is
+    // needed, and a payload landing after this raises IRQ again
     klbn_nrf24l01_clear_status(NRF24L01_STATUS_RX_DR);
+    uint8_t rx_pipe = (last_status & NRF24L01_STATUS_RX_P_NO) >> 1;
+    if (rx_pipe >= NRF24L01_PIPE_COUNT) {
+        return KLBN_NRF24L01_ERROR_RX_EMPTY;
+    }
+    
+    if (!klbn_nrf24l01_read_rx_payload(rx_pipe, data, length)) {
+        return KLBN_NRF24L01_ERROR_RX_EMPTY;
+    }
+    
+    if (pipe != NULL) {
+        *pipe = rx_pipe;
+    }
     
     return KLBN_NRF24L01_OK;
 }
 
+uint8_t klbn_nrf24l01_drain_rx(klbn_nrf24l01_rx_handler_t handler, void *context) {
+    if (!nrf24l01_initialized || handler == NULL) {
+        return 0;
+    }
+    
+    // Payloads landing after this raise IRQ again
+    klbn_nrf24l01_clear_status(NRF24L01_STATUS_RX_DR);
+    
+    uint8_t data[NRF24L01_MAX_PAYLOAD_SIZE];
+    uint8_t count = 0;
+    
+    for (;;) {
+        // The STATUS byte clocked out with FIFO_STATUS names the head pipe
+        uint8_t fifo = klbn_nrf24l01_read_register(NRF24L01_REG_FIFO_STATUS);
+        if (fifo & NRF24L01_FIFO_STATUS_RX_EMPTY) {
+            break;
+        }
+        if (count == 0 && (fifo & NRF24L01_FIFO_STATUS_RX_FULL)) {
+            rx_stats.fifo_full_drains++;
+        }
+        
+        uint8_t rx_pipe = (last_status & NRF24L01_STATUS_RX_P_NO) >> 1;
+        uint8_t length;
+        if (rx_pipe >= NRF24L01_PIPE_COUNT || !klbn_nrf24l01_read_rx_payload(rx_pipe, data, &length)) {
+            break;
+        }
+        
+        count++;
+        handler(data, length, rx_pipe, context);
+    }
+    
+    return count;
+}
+
+bool klbn_nrf24l01_read_rpd(void) {
+    if (!nrf24l01_initialized) {
+        return false;
+    }
+    
+    return (klbn_nrf24l01_read_register(NRF24L01_REG_RPD) & 0x01) != 0;
+}
+
+void klbn_nrf24l01_get_rx_stats(klbn_nrf24l01_rx_stats_t *stats) {
+    if (stats != NULL) {
+        *stats = rx_stats;
+    }
+}
+
 bool klbn_nrf24l01_data_available(void) {
     if (!nrf24l01_initialized) {
         return false;
     }
     
+    // RX_P_NO reads 111 only when the RX FIFO is empty. Unlike RX_DR it stays
+    // valid after the flag is cleared with more payloads still queued.
     uint8_t status = klbn_nrf24l01_get_status();
-    return (status & NRF24L01_STATUS_RX_DR) != 0;
+    return (status & NRF24L01_STATUS_RX_P_NO) != NRF24L01_STATUS_RX_P_NO;
+}
+
+bool klbn_nrf24l01_irq_asserted(void) {
+    // Active low, and held low while any of RX_DR, TX_DS or MAX_RT is set
+    return klbn_gpio_read_pin((uint32_t)KLBN_NRF24L01_IRQ_PORT, KLBN_NRF24L01_IRQ_PIN) == 0;
 }
 
 bool klbn_nrf24l01_tx_complete(void) {
@@ -400,10 +1176,32 @@ uint8_t klbn_nrf24l01_get_status(void) {
     return klbn_nrf24l01_send_command(NRF24L01_CMD_NOP);
 }
 
+uint8_t klbn_nrf24l01_get_cached_status(void) {
+    return last_status;
+}
+
 void klbn_nrf24l01_clear_status(uint8_t flags) {
     klbn_nrf24l01_write_register(NRF24L01_REG_STATUS, flags);
 }
 
+void klbn_nrf24l01_enable_irq(klbn_exti_callback_t callback) {
+    // Map the EXTI line to the IRQ pin's port (GPIOA = 0)
+    AFIO->EXTICR[KLBN_NRF24L01_IRQ_PIN / 4] &= ~(0xF << (4 * (KLBN_NRF24L01_IRQ_PIN % 4)));
+    
+    // IRQ is active low: trigger on the falling edge only
+    EXTI->RTSR &= ~(1 << KLBN_NRF24L01_IRQ_PIN);
+    EXTI->FTSR |= (1 << KLBN_NRF24L01_IRQ_PIN);
+    
+    klbn_exti_register_callback(KLBN_NRF24L01_IRQ_PIN, callback);
+    
+    EXTI->PR = (1 << KLBN_NRF24L01_IRQ_PIN);
+    EXTI->IMR |= (1 << KLBN_NRF24L01_IRQ_PIN);
+    
+    // EXTI9_5 handles EXTI8; the callback may use FreeRTOS FromISR APIs
+    NVIC_SetPriority(EXTI9_5_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+    NVIC_EnableIRQ(EXTI9_5_IRQn);
+}
+
 bool klbn_nrf24l01_test(void) {
     // Test by reading CONFIG register (should be writable)
     uint8_t test_value = 0x55;
@@ -11,6 +11,7 @@
 #include "FreeRTOS.h"
 #include "klbn_gpio.h"
 #include "klbn_pins.h"
+#include "klbn_radio_bench.h"
 #include "klbn_types.h"
 #include "libc_stubs.h"
 #include "task.h"
@@ -27,6 +28,98 @@
 #define BLFM_OLED_MAX_SMALL_TEXT_LEN 12
 #define BLFM_OLED_MAX_BIG_TEXT_LEN 16
 
+/* -------------------- Benchmark Results -------------------- */
+// RTT in microseconds: avg and losses on top, p50/p99/max below
+static bool show_ping_results(klbn_actuator_command_t *out) {
+  klbn_radio_bench_ping_result_t ping;
+  klbn_radio_bench_get_ping(&ping);
+
+  if (ping.state == KLBN_RADIO_BENCH_IDLE) {
+    return false;
+  }
+
+  out->targets = KLBN_ACTUATOR_LED | KLBN_ACTUATOR_OLED;
+  out->led.mode = KLBN_LED_MODE_BLINK;
+  out->led.blink_speed_ms = 500;
+  out->led.pattern_id = KLBN_LED_PATTERN_NONE;
+  out->led.brightness = 100;
+
+  out->oled.icon1 = KLBN_OLED_ICON_NONE;
+  out->oled.icon2 = KLBN_OLED_ICON_NONE;
+  out->oled.icon3 = KLBN_OLED_ICON_NONE;
+  out->oled.icon4 = KLBN_OLED_ICON_NONE;
+  out->oled.invert = 0;
+
+  if (ping.state == KLBN_RADIO_BENCH_RUNNING) {
+    safe_strncpy(out->oled.smalltext1, "PING", BLFM_OLED_MAX_SMALL_TEXT_LEN);
+    simple_sprintf(out->oled.smalltext2, "L%lu", (uint32_t)ping.lost);
+    safe_strncpy(out->oled.bigtext, "RUNNING", BLFM_OLED_MAX_BIG_TEXT_LEN);
+    out->oled.progress_percent =
+        (uint8_t)((uint32_t)ping.sent * 100 / KLBN_RADIO_BENCH_PING_PROBES);
+    return true;
+  }
+
+  // Percentiles are histogram edges (at most 6400), max is capped to keep
+  // "6400/6400/99999" within the big text line
+  uint32_t max_us = (ping.max_us > 99999) ? 99999 : ping.max_us;
+  simple_sprintf(out->oled.smalltext1, "A%lu", ping.avg_us);
+  simple_sprintf(out->oled.smalltext2, "L%lu", (uint32_t)ping.lost);
+  simple_sprintf(out->oled.bigtext, "%lu/%lu/%lu", ping.p50_us, ping.p99_us,
+                 max_us);
+  out->oled.progress_percent = 100;
+  return true;
+}
+
+// Goodput in kbit/s: ours and the rate level on top, the peer's (or the
+// counting end's duplicates and gaps) below
+static bool show_stream_results(klbn_actuator_command_t *out) {
+  klbn_radio_bench_stream_result_t stream;
+  klbn_radio_bench_get_stream(&stream);
+
+  if (stream.state == KLBN_RADIO_BENCH_IDLE) {
+    return false;
+  }
+
+  out->targets = KLBN_ACTUATOR_LED | KLBN_ACTUATOR_OLED;
+  out->led.mode = KLBN_LED_MODE_BLINK;
+  out->led.blink_speed_ms = 500;
+  out->led.pattern_id = KLBN_LED_PATTERN_NONE;
+  out->led.brightness = 100;
+
+  out->oled.icon1 = KLBN_OLED_ICON_NONE;
+  out->oled.icon2 = KLBN_OLED_ICON_NONE;
+  out->oled.icon3 = KLBN_OLED_ICON_NONE;
+  out->oled.icon4 = KLBN_OLED_ICON_NONE;
+  out->oled.invert = 0;
+
+  // A for the ARQ path, N for frames without ACKs, B for plain ACKed ones
+  const char *path = stream.reliable ? "A" : (stream.no_ack ? "N" : "B");
+  simple_sprintf(out->oled.smalltext1, "%s%lu", path,
+                 (uint32_t)stream.payload_size);
+  simple_sprintf(out->oled.smalltext2, "R%lu", (uint32_t)stream.rate_level);
+
+  if (stream.state == KLBN_RADIO_BENCH_RUNNING) {
+    safe_strncpy(out->oled.bigtext, stream.sender ? "STREAM" : "COUNTING",
+                 BLFM_OLED_MAX_BIG_TEXT_LEN);
+    out->oled.progress_percent = 0;
+    return true;
+  }
+
+  // Everything is capped to fit 15 characters; peer_kbps comes off the
+  // air and can be anything
+  uint32_t kbps = (stream.kbps > 9999) ? 9999 : stream.kbps;
+  uint32_t peer_kbps = (stream.peer_kbps > 9999) ? 9999 : stream.peer_kbps;
+  uint32_t dups = (stream.duplicates > 999) ? 999 : stream.duplicates;
+  uint32_t gaps = (stream.gaps > 999) ? 999 : stream.gaps;
+  if (stream.sender) {
+    simple_sprintf(out->oled.bigtext, "%lu>%lu D%lu", kbps, peer_kbps, dups);
+  } else {
+    simple_sprintf(out->oled.bigtext, "%lu D%lu G%lu", kbps, dups, gaps);
+  }
+  out->oled.progress_percent = 100;
+  return true;
+}
+
 /* -------------------- Main Controller Initialization -------------------- */
 void klbn_controller_init(void) {  
   // Controller initialization
@@ -36,16 +129,28 @@ void klbn_controller_init(void) {
 void klbn_controller_process(const klbn_sensor_data_t *in,
                              klbn_actuator_command_t *out) {
   (void)in; 
+
+  // The benchmark run last, from here or the peer, owns the screen
+  klbn_radio_bench_mode_t bench = klbn_radio_bench_get_mode();
+  if ((bench == KLBN_RADIO_BENCH_PING && show_ping_results(out)) ||
+      (bench == KLBN_RADIO_BENCH_STREAM && show_stream_results(out))) {
+    return;
+  }
   
   // Simple LED control - normal blink
+  out->targets = KLBN_ACTUATOR_LED | KLBN_ACTUATOR_OLED;
   out->led.mode = KLBN_LED_MODE_BLINK;
   out->led.blink_speed_ms = 500;
+  out->led.pattern_id = KLBN_LED_PATTERN_NONE;
+  out->led.brightness = 100;
 
   out->oled.icon1 = KLBN_OLED_ICON_NONE;
   out->oled.icon2 = KLBN_OLED_ICON_NONE;
   out->oled.icon3 = KLBN_OLED_ICON_NONE;
   out->oled.icon4 = KLBN_OLED_ICON_NONE;
 
+  out->oled.smalltext1[0] = '\0';
+  out->oled.smalltext2[0] = '\0';
   safe_strncpy(out->oled.bigtext, "KELBARAN 2025", BLFM_OLED_MAX_BIG_TEXT_LEN);
 
   out->oled.invert = 0;
@@ -56,7 +161,8 @@ void klbn_controller_process(const klbn_sensor_data_t *in,
 /* -------------------- Mode Button -------------------- */
 void klbn_controller_process_mode_button(const klbn_mode_button_event_t *event,
                                          klbn_actuator_command_t *out) {
-  (void) out;
+  // Only the debug LED reacts, directly; nothing for the actuator hub
+  out->targets = 0;
   static uint32_t last_press_time = 0;
   
   if (event->event_type == KLBN_MODE_BUTTON_EVENT_PRESSED) {
@@ -11,10 +11,18 @@
 #include "klbn_pins.h"
 #include "klbn_gpio.h"
 #include "stm32f1xx.h"
+#include "FreeRTOS.h"
+#include "task.h"
 
 // SPI1 timeout in loops (adjust based on system clock)
 #define SPI_TIMEOUT_LOOPS 10000
 
+// DMA completion timeout (a 255-byte transfer takes ~0.5ms at 4.5MHz)
+#define SPI_DMA_TIMEOUT_MS 10
+
+// Task notification slot used to signal DMA completion
+#define SPI_DMA_NOTIFY_INDEX 1
+
 // Default SPI configuration for most devices
 static const klbn_spi_config_t default_config = {
     .prescaler = 16,        // 72MHz / 16 = 4.5MHz (safe for most devices)
@@ -26,6 +34,13 @@ static const klbn_spi_config_t default_config = {
 
 static bool spi_initialized = false;
 
+// Task blocked in klbn_spi_transfer_dma(), woken by the DMA interrupt
+static TaskHandle_t spi_dma_task = NULL;
+static volatile klbn_spi_error_t spi_dma_result = KLBN_SPI_OK;
+
+// Stands in for a NULL buffer (zero TX source or discarded RX sink)
+static uint8_t spi_dma_dummy;
+
 /**
  * @brief Configure SPI1 GPIO pins
  */
@@ -66,6 +81,22 @@ static klbn_spi_error_t klbn_spi_wait_flag(uint32_t flag, bool set) {
     return KLBN_SPI_ERROR_TIMEOUT;
 }
 
+/**
+ * @brief Configure DMA1 channel 2 (SPI1_RX) and channel 3 (SPI1_TX)
+ */
+static void klbn_spi_configure_dma(void) {
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    
+    DMA1_Channel2->CCR = 0;
+    DMA1_Channel3->CCR = 0;
+    DMA1_Channel2->CPAR = (uint32_t)&SPI1->DR;
+    DMA1_Channel3->CPAR = (uint32_t)&SPI1->DR;
+    
+    // Only the RX channel interrupts: it completes after the last TX byte
+    NVIC_SetPriority(DMA1_Channel2_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+    NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+}
+
 klbn_spi_error_t klbn_spi_init(const klbn_spi_config_t *config) {
     // Use default config if none provided
     if (config == NULL) {
@@ -124,11 +155,19 @@ klbn_spi_error_t klbn_spi_init(const klbn_spi_config_t *config) {
     // Enable SPI
     SPI1->CR1 |= SPI_CR1_SPE;
     
+    klbn_spi_configure_dma();
+    
     spi_initialized = true;
     return KLBN_SPI_OK;
 }
 
 klbn_spi_error_t klbn_spi_deinit(void) {
+    // Stop DMA requests
+    NVIC_DisableIRQ(DMA1_Channel2_IRQn);
+    SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+    DMA1_Channel2->CCR = 0;
+    DMA1_Channel3->CCR = 0;
+    
     // Disable SPI
     SPI1->CR1 &= ~SPI_CR1_SPE;
     
@@ -174,6 +213,12 @@ klbn_spi_error_t klbn_spi_transfer_multi(const uint8_t *tx_data, uint8_t *rx_dat
         return KLBN_SPI_ERROR_NULL_PTR;
     }
     
+    // Long transfers from a task go through DMA so the CPU is free meanwhile
+    if (length >= KLBN_SPI_DMA_MIN_LENGTH &&
+        xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        return klbn_spi_transfer_dma(tx_data, rx_data, length);
+    }
+    
     for (size_t i = 0; i < length; i++) {
         uint8_t tx_byte = (tx_data != NULL) ? tx_data[i] : 0x00;
         uint8_t rx_byte = klbn_spi_transfer(tx_byte);
@@ -186,6 +231,89 @@ klbn_spi_error_t klbn_spi_transfer_multi(const uint8_t *tx_data, uint8_t *rx_dat
     return KLBN_SPI_OK;
 }
 
+klbn_spi_error_t klbn_spi_transfer_dma(const uint8_t *tx_data, uint8_t *rx_data, size_t length) {
+    if (!spi_initialized) {
+        return KLBN_SPI_ERROR_NOT_INITIALIZED;
+    }
+    
+    if (length == 0) {
+        return KLBN_SPI_OK;
+    }
+    
+    if (tx_data == NULL && rx_data == NULL) {
+        return KLBN_SPI_ERROR_NULL_PTR;
+    }
+    
+    // Make sure no stale byte is waiting in the RX buffer
+    if (klbn_spi_wait_flag(SPI_SR_BSY, false) != KLBN_SPI_OK) {
+        return KLBN_SPI_ERROR_BUSY;
+    }
+    (void)SPI1->DR;
+    
+    spi_dma_dummy = 0x00;
+    
+    DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+    
+    DMA1_Channel2->CMAR = (rx_data != NULL) ? (uint32_t)rx_data : (uint32_t)&spi_dma_dummy;
+    DMA1_Channel2->CNDTR = (uint16_t)length;
+    DMA1_Channel3->CMAR = (tx_data != NULL) ? (uint32_t)tx_data : (uint32_t)&spi_dma_dummy;
+    DMA1_Channel3->CNDTR = (uint16_t)length;
+    
+    // Drop any completion left over from a transfer that timed out
+    spi_dma_task = xTaskGetCurrentTaskHandle();
+    spi_dma_result = KLBN_SPI_OK;
+    xTaskNotifyStateClearIndexed(NULL, SPI_DMA_NOTIFY_INDEX);
+    ulTaskNotifyValueClearIndexed(NULL, SPI_DMA_NOTIFY_INDEX, 0xFFFFFFFFUL);
+    
+    // RX channel has the higher priority so no received byte is overrun
+    DMA1_Channel2->CCR = DMA_CCR_PL_1 | DMA_CCR_TCIE | DMA_CCR_TEIE |
+                         ((rx_data != NULL) ? DMA_CCR_MINC : 0) | DMA_CCR_EN;
+    DMA1_Channel3->CCR = DMA_CCR_PL_0 | DMA_CCR_DIR |
+                         ((tx_data != NULL) ? DMA_CCR_MINC : 0) | DMA_CCR_EN;
+    
+    // Start clocking
+    SPI1->CR2 |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+    
+    klbn_spi_error_t result = KLBN_SPI_OK;
+    if (ulTaskNotifyTakeIndexed(SPI_DMA_NOTIFY_INDEX, pdTRUE,
+                                pdMS_TO_TICKS(SPI_DMA_TIMEOUT_MS)) == 0) {
+        result = KLBN_SPI_ERROR_TIMEOUT;
+    } else {
+        result = spi_dma_result;
+    }
+    
+    SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+    DMA1_Channel2->CCR = 0;
+    DMA1_Channel3->CCR = 0;
+    spi_dma_task = NULL;
+    
+    return result;
+}
+
+/**
+ * @brief SPI1 RX DMA interrupt: wake the task waiting on the transfer
+ */
+void DMA1_Channel2_IRQHandler(void) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint32_t isr = DMA1->ISR;
+    
+    if (!(isr & (DMA_ISR_TCIF2 | DMA_ISR_TEIF2))) {
+        return;
+    }
+    
+    DMA1->IFCR = DMA_IFCR_CGIF2;
+    DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+    
+    spi_dma_result = (isr & DMA_ISR_TEIF2) ? KLBN_SPI_ERROR_DMA : KLBN_SPI_OK;
+    
+    if (spi_dma_task != NULL) {
+        vTaskNotifyGiveIndexedFromISR(spi_dma_task, SPI_DMA_NOTIFY_INDEX,
+                                      &xHigherPriorityTaskWoken);
+    }
+    
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 void klbn_spi_cs_low(void) {
     klbn_gpio_clear_pin((uint32_t)KLBN_SPI_CS_PORT, KLBN_SPI_CS_PIN);
 }
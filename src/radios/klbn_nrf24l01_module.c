@@ -9,16 +9,79 @@
 
 #include "klbn_nrf24l01_module.h"
 #include "klbn_nrf24l01.h"
+#include "klbn_radio_link_stats.h"
 #include "FreeRTOS.h"
 #include "task.h"
 
 #include <stdbool.h>
 
 static bool module_initialized = false;
+static SemaphoreHandle_t radio_irq_signal = NULL;
+static TickType_t last_check = 0;
 
-void klbn_nrf24l01_module_init(void) {
-  // Initialize NRF24L01 with default settings
-  if (klbn_nrf24l01_init(NULL) == KLBN_NRF24L01_OK) {
+// How often the radio is checked for a brownout
+#define NRF24L01_CHECK_PERIOD pdMS_TO_TICKS(1000)
+
+// Pending async sends, one slot per driver TX queue entry
+typedef struct {
+  klbn_radio_tx_callback_t callback;
+  void *context;
+  bool used;
+} tx_request_t;
+
+static tx_request_t tx_requests[NRF24L01_TX_QUEUE_LENGTH];
+
+// Driver defaults, with replies carried on auto-ACKs
+static const klbn_nrf24l01_config_t radio_config = {
+  .channel = NRF24L01_DEFAULT_CHANNEL,
+  .power = KLBN_NRF24L01_POWER_0DBM,
+  .datarate = KLBN_NRF24L01_DATARATE_1MBPS,
+  .retries = NRF24L01_DEFAULT_RETRIES,
+  .delay = NRF24L01_DEFAULT_DELAY,
+  .auto_ack = true,
+  .dynamic_payload = true,
+  .payload_size = NRF24L01_MAX_PAYLOAD_SIZE,
+  .rx_pipes = 0x01,
+  .ack_payload = true
+};
+
+static void nrf24l01_tx_complete(klbn_nrf24l01_error_t result,
+                                 uint8_t retransmits, void *context) {
+  tx_request_t *request = (tx_request_t *)context;
+
+  klbn_radio_tx_callback_t callback = request->callback;
+  void *user_context = request->context;
+  request->used = false;
+
+  // ARC is only known for the last payload of a batch; the rest count as
+  // delivered but stay out of the retransmit average
+  uint8_t arc = (retransmits == NRF24L01_ARC_UNKNOWN)
+                    ? KLBN_RADIO_RETRANSMITS_UNKNOWN
+                    : retransmits;
+  klbn_radio_link_stats_tx(KLBN_RADIO_LINK_TX, result == KLBN_NRF24L01_OK, arc);
+
+  if (callback == NULL) {
+    return;
+  }
+
+  callback((result == KLBN_NRF24L01_OK) ? KLBN_RADIO_TX_OK : KLBN_RADIO_TX_FAILED,
+           arc, user_context);
+}
+
+static void nrf24l01_irq_handler(void) {
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+  if (radio_irq_signal != NULL) {
+    xSemaphoreGiveFromISR(radio_irq_signal, &xHigherPriorityTaskWoken);
+  }
+
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void klbn_nrf24l01_module_init(SemaphoreHandle_t irq_signal) {
+  radio_irq_signal = irq_signal;
+
+  if (klbn_nrf24l01_init(&radio_config) == KLBN_NRF24L01_OK) {
     // Set default addresses - basic setup only
     uint8_t address[5] = {0x01, 0x02, 0x03, 0x04, 0x05};
     klbn_nrf24l01_set_rx_address(address);
@@ -26,6 +89,9 @@ void klbn_nrf24l01_module_init(void) {
     
     // Start in RX mode
     klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_RX);
+
+    // Wake the radio hub from the IRQ line instead of polling STATUS
+    klbn_nrf24l01_enable_irq(nrf24l01_irq_handler);
     
     module_initialized = true;
   }
@@ -36,24 +102,197 @@ bool klbn_nrf24l01_module_receive(klbn_radio_data_t *out) {
     return false;
   }
 
-  // Check for incoming radio data
-  if (klbn_nrf24l01_data_available()) {
-    if (klbn_nrf24l01_receive(out->data, &out->length) == KLBN_NRF24L01_OK) {
-      out->timestamp = xTaskGetTickCount();
-      return true;
-    }
+  // klbn_nrf24l01_receive() checks the RX FIFO itself
+  if (klbn_nrf24l01_receive_pipe(out->data, &out->length, &out->pipe) ==
+      KLBN_NRF24L01_OK) {
+    out->timestamp = xTaskGetTickCount();
+    return true;
   }
   
   return false;
 }
 
-void klbn_nrf24l01_module_send(const klbn_radio_command_t *cmd) {
+typedef struct {
+  klbn_radio_rx_handler_t handler;
+  void *context;
+  uint8_t last_pipe;
+} rx_drain_t;
+
+static void nrf24l01_rx_payload(const uint8_t *data, uint8_t length,
+                                uint8_t pipe, void *context) {
+  rx_drain_t *drain = (rx_drain_t *)context;
+  klbn_radio_data_t out;
+
+  for (uint8_t i = 0; i < length; i++) {
+    out.data[i] = data[i];
+  }
+  out.length = length;
+  out.pipe = pipe;
+  out.timestamp = xTaskGetTickCount();
+  drain->last_pipe = pipe;
+  klbn_radio_link_stats_rx(pipe);
+
+  drain->handler(&out, drain->context);
+}
+
+uint8_t klbn_nrf24l01_module_drain(klbn_radio_rx_handler_t handler,
+                                   void *context) {
+  if (!handler || !module_initialized) {
+    return 0;
+  }
+
+  rx_drain_t drain = {handler, context, 0};
+  uint8_t count = klbn_nrf24l01_drain_rx(nrf24l01_rx_payload, &drain);
+
+  // RPD latches per packet, so it only describes the last one read
+  if (count > 0) {
+    klbn_radio_link_stats_rpd(drain.last_pipe, klbn_nrf24l01_read_rpd());
+  }
+
+  return count;
+}
+
+uint32_t klbn_nrf24l01_module_rx_overflows(void) {
+  klbn_nrf24l01_rx_stats_t stats;
+
+  klbn_nrf24l01_get_rx_stats(&stats);
+  return stats.fifo_full_drains;
+}
+
+bool klbn_nrf24l01_module_send(const klbn_radio_command_t *cmd) {
+  return klbn_nrf24l01_module_send_async(cmd, NULL, NULL);
+}
+
+bool klbn_nrf24l01_module_send_async(const klbn_radio_command_t *cmd,
+                                     klbn_radio_tx_callback_t callback,
+                                     void *context) {
   if (!cmd || !module_initialized) {
+    return false;
+  }
+
+  // The driver stays in TX mode while payloads keep coming and returns
+  // to RX by itself once its queue drains. Every send takes a request slot
+  // so its outcome reaches the link statistics.
+  tx_request_t *request = NULL;
+  for (uint8_t i = 0; i < NRF24L01_TX_QUEUE_LENGTH; i++) {
+    if (!tx_requests[i].used) {
+      request = &tx_requests[i];
+      break;
+    }
+  }
+  if (request == NULL) {
+    return false;
+  }
+
+  request->callback = callback;
+  request->context = context;
+  request->used = true;
+
+  if (klbn_nrf24l01_transmit_async(cmd->data, cmd->length, nrf24l01_tx_complete,
+                                   request) != KLBN_NRF24L01_OK) {
+    request->used = false;
+    return false;
+  }
+
+  return true;
+}
+
+void klbn_nrf24l01_module_service(void) {
+  if (!module_initialized) {
     return;
   }
 
-  // Switch to TX mode, send, then back to RX
-  klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_TX);
-  klbn_nrf24l01_transmit(cmd->data, cmd->length);
-  klbn_nrf24l01_set_mode(KLBN_NRF24L01_MODE_RX);
-}
\ No newline at end of file
+  klbn_nrf24l01_service();
+}
+
+bool klbn_nrf24l01_module_irq_pending(void) {
+  return module_initialized && klbn_nrf24l01_irq_asserted();
+}
+
+bool klbn_nrf24l01_module_broadcast(const klbn_radio_command_t *cmd,
+                                    uint8_t repeats) {
+  if (!cmd || !module_initialized) {
+    return false;
+  }
+
+  return klbn_nrf24l01_broadcast(cmd->data, cmd->length, repeats) ==
+         KLBN_NRF24L01_OK;
+}
+
+bool klbn_nrf24l01_module_queue_reply(uint8_t pipe,
+                                      const klbn_radio_command_t *cmd) {
+  if (!cmd || !module_initialized) {
+    return false;
+  }
+
+  // Goes out on the ACK of the next packet received on this pipe
+  return klbn_nrf24l01_write_ack_payload(pipe, cmd->data, cmd->length) ==
+         KLBN_NRF24L01_OK;
+}
+
+bool klbn_nrf24l01_module_set_rf(klbn_nrf24l01_datarate_t datarate,
+                                 klbn_nrf24l01_power_t power) {
+  if (!module_initialized) {
+    return false;
+  }
+
+  return klbn_nrf24l01_set_rf(datarate, power) == KLBN_NRF24L01_OK;
+}
+
+bool klbn_nrf24l01_module_set_channel(uint8_t channel) {
+  if (!module_initialized) {
+    return false;
+  }
+
+  return klbn_nrf24l01_set_channel(channel) == KLBN_NRF24L01_OK;
+}
+
+uint8_t klbn_nrf24l01_module_get_channel(void) {
+  return klbn_nrf24l01_get_channel();
+}
+
+bool klbn_nrf24l01_module_tx_idle(void) {
+  return klbn_nrf24l01_stream_idle();
+}
+
+uint8_t klbn_nrf24l01_module_sample_channel(uint8_t channel, uint8_t samples) {
+  if (!module_initialized) {
+    return 0;
+  }
+
+  return klbn_nrf24l01_sample_carrier(channel, samples);
+}
+
+void klbn_nrf24l01_module_check(void) {
+  if (!module_initialized) {
+    return;
+  }
+
+  TickType_t now = xTaskGetTickCount();
+  if ((now - last_check) < NRF24L01_CHECK_PERIOD) {
+    return;
+  }
+  last_check = now;
+
+  // A supply dip resets the radio to power-down without any IRQ
+  if (!klbn_nrf24l01_config_intact()) {
+    klbn_nrf24l01_reinit();
+  }
+}
+
+bool klbn_nrf24l01_module_open_pipe(uint8_t pipe, const uint8_t *address) {
+  if (!address || !module_initialized) {
+    return false;
+  }
+
+  // Pipe 0 doubles as the auto-ack pipe for TX, keep it on the TX address
+  if (pipe == 0) {
+    return false;
+  }
+
+  if (klbn_nrf24l01_set_pipe_address(pipe, address) != KLBN_NRF24L01_OK) {
+    return false;
+  }
+
+  return klbn_nrf24l01_enable_pipe(pipe, true) == KLBN_NRF24L01_OK;
+}
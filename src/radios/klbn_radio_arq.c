@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_arq.h"
+#include "klbn_radio_hub.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32f1xx.h"
+
+#include <stdint.h>
+
+// ARQ_ACK frame: the session acknowledged, the next expected sequence
+// number, then bit n set when sequence number (next expected + n) is
+// buffered at the receiver
+#define ARQ_ACK_SIZE 3
+
+typedef enum {
+  ARQ_SLOT_FREE = 0,   // unused, or acknowledged
+  ARQ_SLOT_PENDING,    // waiting for room in the radio queue
+  ARQ_SLOT_INFLIGHT,   // sent, waiting for the ARQ_ACK
+} arq_slot_state_t;
+
+typedef struct {
+  arq_slot_state_t state;
+  bool in_radio;       // radio completion still outstanding
+  uint8_t seq;
+  uint8_t length;
+  uint8_t retries;
+  uint32_t sent_ms;
+  uint8_t data[KLBN_RADIO_ARQ_MAX_PAYLOAD];
+} arq_tx_slot_t;
+
+typedef struct {
+  bool present;
+  uint8_t length;
+  uint8_t pipe;
+  uint8_t data[KLBN_RADIO_ARQ_MAX_PAYLOAD];
+} arq_rx_slot_t;
+
+// Sender: [send_base, next_seq) are in the window
+static arq_tx_slot_t tx_slots[KLBN_RADIO_ARQ_WINDOW];
+static uint8_t send_base = 0;
+static uint8_t next_seq = 0;
+static uint8_t tx_session = 0;
+static bool seq_seeded = false;
+
+// Receiver: rcv_base is the next sequence number to release, and the
+// rcv_skip after it were abandoned by the sender and are not waited for
+static arq_rx_slot_t rx_slots[KLBN_RADIO_ARQ_WINDOW];
+static uint8_t rcv_base = 0;
+static uint8_t rcv_skip = 0;
+static uint8_t rcv_session = 0;
+static bool rcv_synced = false;
+static bool ack_pending = false;
+
+// The last send found the radio queue full: a TX completion wakes the hub
+// task when there is room again
+static bool radio_full = false;
+
+// RTT estimation (RFC 6298), in milliseconds
+static bool rtt_valid = false;
+static uint32_t srtt_ms = 0;
+static uint32_t rttvar_ms = 0;
+static uint32_t rto_ms = KLBN_RADIO_ARQ_RTO_INIT_MS;
+
+static klbn_radio_arq_stats_t stats;
+
+static uint32_t clamp_rto(uint32_t rto) {
+  if (rto < KLBN_RADIO_ARQ_RTO_MIN_MS) {
+    return KLBN_RADIO_ARQ_RTO_MIN_MS;
+  }
+  if (rto > KLBN_RADIO_ARQ_RTO_MAX_MS) {
+    return KLBN_RADIO_ARQ_RTO_MAX_MS;
+  }
+  return rto;
+}
+
+static void rtt_sample(uint32_t rtt) {
+  if (!rtt_valid) {
+    srtt_ms = rtt;
+    rttvar_ms = rtt / 2;
+    rtt_valid = true;
+  } else {
+    uint32_t error = (srtt_ms > rtt) ? srtt_ms - rtt : rtt - srtt_ms;
+    rttvar_ms = (3 * rttvar_ms + error) / 4;
+    srtt_ms = (7 * srtt_ms + rtt) / 8;
+  }
+
+  rto_ms = clamp_rto(srtt_ms + 4 * rttvar_ms);
+}
+
+static bool in_window(uint8_t seq) {
+  return (uint8_t)(seq - send_base) < (uint8_t)(next_seq - send_base);
+}
+
+static void arq_tx_complete(klbn_radio_tx_result_t result,
+                            uint8_t retransmits, void *context);
+
+static void transmit(arq_tx_slot_t *slot, uint32_t now_ms) {
+  uint8_t payload[KLBN_RADIO_ARQ_HEADER_SIZE + KLBN_RADIO_ARQ_MAX_PAYLOAD];
+
+  // The base lets the receiver stop waiting for payloads given up on here
+  payload[0] = tx_session;
+  payload[1] = slot->seq;
+  payload[2] = send_base;
+  for (uint8_t i = 0; i < slot->length; i++) {
+    payload[KLBN_RADIO_ARQ_HEADER_SIZE + i] = slot->data[i];
+  }
+
+  if (klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_ARQ_DATA, payload,
+                                KLBN_RADIO_ARQ_HEADER_SIZE + slot->length,
+                                arq_tx_complete,
+                                (void *)(uintptr_t)slot->seq)) {
+    slot->state = ARQ_SLOT_INFLIGHT;
+    slot->in_radio = true;
+    slot->sent_ms = now_ms;
+    radio_full = false;
+  } else {
+    radio_full = true;
+  }
+}
+
+// Queue a resend, or give up on the payload
+static void retransmit(arq_tx_slot_t *slot) {
+  if (++slot->retries > KLBN_RADIO_ARQ_MAX_RETRIES) {
+    slot->state = ARQ_SLOT_FREE;
+    stats.failed++;
+    return;
+  }
+
+  slot->state = ARQ_SLOT_PENDING;
+  stats.retransmits++;
+}
+
+static void arq_tx_complete(klbn_radio_tx_result_t result,
+                            uint8_t retransmits, void *context) {
+  (void)retransmits;
+  uint8_t seq = (uint8_t)(uintptr_t)context;
+  arq_tx_slot_t *slot = &tx_slots[seq % KLBN_RADIO_ARQ_WINDOW];
+
+  if (!in_window(seq) || slot->seq != seq || slot->state != ARQ_SLOT_INFLIGHT) {
+    return;
+  }
+  slot->in_radio = false;
+
+  // The radio already gave up, no point waiting out the timer
+  if (result != KLBN_RADIO_TX_OK) {
+    retransmit(slot);
+  }
+}
+
+static void advance_send_base(void) {
+  while (send_base != next_seq &&
+         tx_slots[send_base % KLBN_RADIO_ARQ_WINDOW].state == ARQ_SLOT_FREE) {
+    send_base++;
+  }
+}
+
+// Step over abandoned sequence numbers with nothing buffered for them
+static void skip_abandoned(void) {
+  while (rcv_skip > 0 && !rx_slots[rcv_base % KLBN_RADIO_ARQ_WINDOW].present) {
+    rcv_base++;
+    rcv_skip--;
+    stats.skipped++;
+  }
+}
+
+// Line the receive window up with the sender's session and base
+static void follow_base(uint8_t session, uint8_t base) {
+  uint8_t ahead = (uint8_t)(base - rcv_base);
+
+  if (rcv_synced && session == rcv_session) {
+    // At or behind our base: the sender has not seen our latest ACK yet
+    if (ahead == 0 || ahead > UINT8_MAX / 2) {
+      return;
+    }
+
+    // The sender gave up on everything before its base
+    if (ahead <= KLBN_RADIO_ARQ_WINDOW) {
+      if (ahead > rcv_skip) {
+        rcv_skip = ahead;
+      }
+      return;
+    }
+  }
+
+  // First contact, a restarted sender, or a base past everything we hold:
+  // start over at the base
+  for (uint8_t i = 0; i < KLBN_RADIO_ARQ_WINDOW; i++) {
+    rx_slots[i].present = false;
+  }
+  if (rcv_synced) {
+    stats.resyncs++;
+  }
+  rcv_session = session;
+  rcv_base = base;
+  rcv_skip = 0;
+  rcv_synced = true;
+}
+
+static void send_ack(void) {
+  uint8_t payload[ARQ_ACK_SIZE] = {rcv_session, rcv_base, 0};
+
+  for (uint8_t i = 0; i < KLBN_RADIO_ARQ_WINDOW; i++) {
+    if (rx_slots[(uint8_t)(rcv_base + i) % KLBN_RADIO_ARQ_WINDOW].present) {
+      payload[2] |= 1 << i;
+    }
+  }
+
+  if (klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_ARQ_ACK, payload,
+                                ARQ_ACK_SIZE, NULL, NULL)) {
+    ack_pending = false;
+    radio_full = false;
+  } else {
+    radio_full = true;
+  }
+}
+
+void klbn_radio_arq_init(void) {
+  for (uint8_t i = 0; i < KLBN_RADIO_ARQ_WINDOW; i++) {
+    tx_slots[i].state = ARQ_SLOT_FREE;
+    rx_slots[i].present = false;
+  }
+
+  send_base = next_seq = 0;
+  seq_seeded = false;
+  rcv_session = 0;
+  rcv_base = 0;
+  rcv_skip = 0;
+  rcv_synced = false;
+  ack_pending = false;
+  radio_full = false;
+  rtt_valid = false;
+  rto_ms = KLBN_RADIO_ARQ_RTO_INIT_MS;
+}
+
+bool klbn_radio_arq_send(const uint8_t *data, uint8_t length, bool urgent) {
+  if (!data || length == 0 || length > KLBN_RADIO_ARQ_MAX_PAYLOAD) {
+    return false;
+  }
+
+  // The cycle count at the first send varies with the radio traffic since
+  // boot, unlike at init. A random first sequence number also keeps a
+  // session that happens to repeat from lining up with the old window.
+  if (!seq_seeded) {
+    uint32_t seed = DWT->CYCCNT;
+    tx_session = (uint8_t)(seed ^ (seed >> 16));
+    send_base = next_seq = (uint8_t)((seed >> 8) ^ (seed >> 24));
+    seq_seeded = true;
+  }
+
+  if (klbn_radio_arq_room(urgent) == 0) {
+    return false;
+  }
+
+  arq_tx_slot_t *slot = &tx_slots[next_seq % KLBN_RADIO_ARQ_WINDOW];
+  slot->seq = next_seq++;
+  slot->length = length;
+  slot->retries = 0;
+  slot->in_radio = false;
+  for (uint8_t i = 0; i < length; i++) {
+    slot->data[i] = data[i];
+  }
+  slot->state = ARQ_SLOT_PENDING;
+  stats.sent++;
+
+  transmit(slot, xTaskGetTickCount() * portTICK_PERIOD_MS);
+  return true;
+}
+
+uint8_t klbn_radio_arq_room(bool urgent) {
+  uint8_t used = (uint8_t)(next_seq - send_base);
+  uint8_t limit = urgent ? KLBN_RADIO_ARQ_WINDOW
+                         : KLBN_RADIO_ARQ_WINDOW - KLBN_RADIO_ARQ_URGENT_SLOTS;
+
+  return (used >= limit) ? 0 : limit - used;
+}
+
+bool klbn_radio_arq_pop(klbn_radio_data_t *out) {
+  if (!out) {
+    return false;
+  }
+
+  skip_abandoned();
+
+  arq_rx_slot_t *slot = &rx_slots[rcv_base % KLBN_RADIO_ARQ_WINDOW];
+  if (!slot->present) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < slot->length; i++) {
+    out->data[i] = slot->data[i];
+  }
+  out->length = slot->length;
+  out->pipe = slot->pipe;
+  out->timestamp = xTaskGetTickCount();
+
+  slot->present = false;
+  rcv_base++;
+  if (rcv_skip > 0) {
+    rcv_skip--;
+  }
+  stats.delivered++;
+  return true;
+}
+
+void klbn_radio_arq_update(uint32_t now_ms) {
+  bool timed_out = false;
+
+  if (ack_pending) {
+    send_ack();
+  }
+
+  for (uint8_t seq = send_base; seq != next_seq; seq++) {
+    arq_tx_slot_t *slot = &tx_slots[seq % KLBN_RADIO_ARQ_WINDOW];
+
+    if (slot->state == ARQ_SLOT_INFLIGHT && !slot->in_radio &&
+        (now_ms - slot->sent_ms) >= rto_ms) {
+      timed_out = true;
+      retransmit(slot);
+    }
+
+    if (slot->state == ARQ_SLOT_PENDING) {
+      transmit(slot, now_ms);
+    }
+  }
+
+  // Back off until an ACK brings a fresh sample: once per pass, slots
+  // sent together time out together
+  if (timed_out) {
+    rto_ms = clamp_rto(rto_ms * 2);
+  }
+
+  advance_send_base();
+}
+
+void klbn_radio_arq_handle_data(const uint8_t *payload, uint8_t length,
+                                uint8_t pipe, uint32_t now_ms) {
+  (void)now_ms;
+
+  if (!payload || length <= KLBN_RADIO_ARQ_HEADER_SIZE ||
+      length - KLBN_RADIO_ARQ_HEADER_SIZE > KLBN_RADIO_ARQ_MAX_PAYLOAD) {
+    return;
+  }
+
+  uint8_t seq = payload[1];
+  follow_base(payload[0], payload[2]);
+  skip_abandoned();
+
+  uint8_t offset = (uint8_t)(seq - rcv_base);
+  arq_rx_slot_t *slot = &rx_slots[seq % KLBN_RADIO_ARQ_WINDOW];
+
+  // Even a duplicate needs an answer, our last ACK may have been lost
+  ack_pending = true;
+
+  // Behind the window it is a resend of a payload already released. Ahead
+  // of it only while skipped-over payloads still wait to be popped: left
+  // unacknowledged, it is resent later.
+  if (offset >= KLBN_RADIO_ARQ_WINDOW) {
+    if ((uint8_t)(rcv_base - seq) <= KLBN_RADIO_ARQ_WINDOW) {
+      stats.duplicates++;
+    }
+    return;
+  }
+  if (slot->present) {
+    stats.duplicates++;
+    return;
+  }
+
+  slot->length = length - KLBN_RADIO_ARQ_HEADER_SIZE;
+  slot->pipe = pipe;
+  for (uint8_t i = 0; i < slot->length; i++) {
+    slot->data[i] = payload[KLBN_RADIO_ARQ_HEADER_SIZE + i];
+  }
+  slot->present = true;
+}
+
+void klbn_radio_arq_handle_ack(const uint8_t *payload, uint8_t length,
+                               uint32_t now_ms) {
+  if (!payload || length < ARQ_ACK_SIZE) {
+    return;
+  }
+
+  // ACKs for a session of ours from before a restart
+  if (!seq_seeded || payload[0] != tx_session) {
+    return;
+  }
+
+  uint8_t cumulative = payload[1];
+  uint8_t selective = payload[2];
+
+  for (uint8_t seq = send_base; seq != next_seq; seq++) {
+    arq_tx_slot_t *slot = &tx_slots[seq % KLBN_RADIO_ARQ_WINDOW];
+    uint8_t ahead = (uint8_t)(seq - cumulative);
+    bool acked = (uint8_t)(cumulative - seq - 1) < KLBN_RADIO_ARQ_WINDOW ||
+                 (ahead < KLBN_RADIO_ARQ_WINDOW && (selective & (1 << ahead)));
+
+    if (!acked || slot->state == ARQ_SLOT_FREE) {
+      continue;
+    }
+
+    // Karn: a resent payload's ACK cannot be matched to one send
+    if (slot->retries == 0 && slot->state == ARQ_SLOT_INFLIGHT) {
+      rtt_sample(now_ms - slot->sent_ms);
+    }
+    slot->state = ARQ_SLOT_FREE;
+  }
+
+  advance_send_base();
+}
+
+void klbn_radio_arq_get_stats(klbn_radio_arq_stats_t *out) {
+  if (!out) {
+    return;
+  }
+
+  *out = stats;
+  out->srtt_ms = (uint16_t)srtt_ms;
+  out->rto_ms = (uint16_t)rto_ms;
+}
+
+uint32_t klbn_radio_arq_next_ms(uint32_t now_ms) {
+  uint32_t next = UINT32_MAX;
+
+  if (ack_pending && !radio_full) {
+    return 0;
+  }
+
+  for (uint8_t seq = send_base; seq != next_seq; seq++) {
+    const arq_tx_slot_t *slot = &tx_slots[seq % KLBN_RADIO_ARQ_WINDOW];
+
+    if (slot->state == ARQ_SLOT_PENDING && !radio_full) {
+      return 0;
+    }
+
+    // Still in the radio: its completion wakes the hub first
+    if (slot->state == ARQ_SLOT_INFLIGHT && !slot->in_radio) {
+      uint32_t waited = now_ms - slot->sent_ms;
+      uint32_t left = (waited >= rto_ms) ? 0 : rto_ms - waited;
+      if (left < next) {
+        next = left;
+      }
+    }
+  }
+
+  return next;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_batch.h"
+#include "klbn_radio_arq.h"
+
+#include <stdint.h>
+
+// Batch being filled
+static uint8_t tx_batch[KLBN_RADIO_BATCH_SIZE];
+static uint8_t tx_length = 0;
+static uint32_t tx_deadline_ms = 0;
+static uint32_t batch_deadline_ms = KLBN_RADIO_BATCH_DEADLINE_MS;
+
+// Payload being unpacked
+static klbn_radio_data_t rx_batch;
+static uint8_t rx_offset = 0;
+
+static bool flush(bool urgent) {
+  if (tx_length == 0) {
+    return true;
+  }
+
+  if (!klbn_radio_arq_send(tx_batch, tx_length, urgent)) {
+    return false;
+  }
+  tx_length = 0;
+  return true;
+}
+
+void klbn_radio_batch_init(void) {
+  tx_length = 0;
+  rx_batch.length = 0;
+  rx_offset = 0;
+}
+
+void klbn_radio_batch_set_deadline(uint32_t deadline_ms) {
+  batch_deadline_ms = deadline_ms;
+}
+
+bool klbn_radio_batch_add(const uint8_t *data, uint8_t length,
+                          bool urgent, uint32_t now_ms) {
+  if (!data || length == 0 || length > KLBN_RADIO_BATCH_MAX_RECORD) {
+    return false;
+  }
+
+  bool fits = tx_length + 1 + length <= KLBN_RADIO_BATCH_SIZE;
+
+  // An urgent record goes out now, with the partial batch ahead of it if
+  // it does not fit: refuse it unless the window takes both
+  if (urgent && klbn_radio_arq_room(true) < (fits ? 1 : 2)) {
+    return false;
+  }
+
+  // No room left, the batch goes out as it is
+  if (!fits && !flush(urgent)) {
+    return false;
+  }
+
+  if (tx_length == 0) {
+    tx_deadline_ms = now_ms + batch_deadline_ms;
+  }
+
+  tx_batch[tx_length++] = length;
+  for (uint8_t i = 0; i < length; i++) {
+    tx_batch[tx_length++] = data[i];
+  }
+
+  // Not even a one byte record fits, or nothing may wait
+  if (tx_length + 2 > KLBN_RADIO_BATCH_SIZE || batch_deadline_ms == 0 ||
+      urgent) {
+    flush(urgent);
+  }
+  return true;
+}
+
+void klbn_radio_batch_update(uint32_t now_ms) {
+  if (tx_length > 0 && (int32_t)(now_ms - tx_deadline_ms) >= 0) {
+    flush(false);
+  }
+}
+
+bool klbn_radio_batch_pop(klbn_radio_data_t *out) {
+  if (!out) {
+    return false;
+  }
+
+  while (rx_offset >= rx_batch.length) {
+    if (!klbn_radio_arq_pop(&rx_batch)) {
+      return false;
+    }
+    rx_offset = 0;
+  }
+
+  uint8_t length = rx_batch.data[rx_offset];
+
+  // Malformed, drop the rest of the payload
+  if (length == 0 || rx_offset + 1 + length > rx_batch.length) {
+    rx_offset = rx_batch.length;
+    return klbn_radio_batch_pop(out);
+  }
+
+  for (uint8_t i = 0; i < length; i++) {
+    out->data[i] = rx_batch.data[rx_offset + 1 + i];
+  }
+  out->length = length;
+  out->pipe = rx_batch.pipe;
+  out->timestamp = rx_batch.timestamp;
+  rx_offset += 1 + length;
+  return true;
+}
+
+uint32_t klbn_radio_batch_next_ms(uint32_t now_ms) {
+  // A full window is freed by an ARQ_ACK or a timeout, both of which
+  // wake the hub task; the deadline cannot be met before that
+  if (tx_length == 0 || klbn_radio_arq_room(false) == 0) {
+    return UINT32_MAX;
+  }
+
+  int32_t left = (int32_t)(tx_deadline_ms - now_ms);
+  return (left > 0) ? (uint32_t)left : 0;
+}
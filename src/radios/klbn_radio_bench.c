@@ -0,0 +1,689 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_bench.h"
+#include "klbn_radio_hub.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_rate.h"
+#include "klbn_radio_sched.h"
+#include "klbn_radio_arq.h"
+#include "klbn_radio_batch.h"
+#include "klbn_nrf24l01_module.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32f1xx.h"
+
+#include <stdint.h>
+
+typedef enum {
+  BENCH_OP_PING = 1,
+  BENCH_OP_PONG,      // the probe sent back unchanged but for the op
+  BENCH_OP_START,     // stream begins, the receiver resets its counters
+  BENCH_OP_END,       // stream over, the receiver answers with REPORT
+  BENCH_OP_REPORT,
+} bench_op_t;
+
+// PING/PONG frame: op, sequence (2), sender's DWT cycle count (4)
+#define BENCH_PROBE_SIZE 7
+// START: op, payload size, no-ack, reliable
+#define BENCH_START_SIZE 4
+// END: op, packets handed to the hub (4)
+#define BENCH_END_SIZE 5
+// REPORT: op, unique bytes (4), duplicates (4), gaps (4), elapsed ms (4)
+#define BENCH_REPORT_SIZE 17
+
+// Stream payloads are application data: marker, sequence (4), filler
+#define BENCH_STREAM_MARKER 0xB7
+
+#define BENCH_CONTROL_RETRY_MS 100  // START and END resend period
+#define BENCH_CONTROL_TRIES    10
+#define BENCH_DRAIN_MS         1000 // wait for the radio queue to empty
+#define BENCH_RX_IDLE_MS       2000 // receiver gives up on a silent sender
+
+typedef enum {
+  STREAM_PHASE_START = 0,
+  STREAM_PHASE_SEND,
+  STREAM_PHASE_DRAIN,
+  STREAM_PHASE_END,
+} stream_phase_t;
+
+static volatile klbn_radio_bench_mode_t requested = KLBN_RADIO_BENCH_NONE;
+static volatile klbn_radio_bench_mode_t last_mode = KLBN_RADIO_BENCH_NONE;
+
+static klbn_radio_bench_ping_result_t ping;
+static uint16_t rtt_hist[KLBN_RADIO_BENCH_HIST_BINS];
+static uint32_t rtt_sum_us = 0;   // 200 probes of at most 200 ms fit
+static uint16_t probe_seq = 0;
+static bool probe_outstanding = false;
+static uint32_t probe_sent_ms = 0;
+
+static klbn_radio_bench_stream_result_t stream;
+static uint8_t stream_payload_size = KLBN_RADIO_BENCH_STREAM_PAYLOAD;
+static bool stream_no_ack = KLBN_RADIO_BENCH_STREAM_NO_ACK;
+static bool stream_reliable = KLBN_RADIO_BENCH_STREAM_RELIABLE;
+
+// Sender
+static stream_phase_t stream_phase = STREAM_PHASE_START;
+static uint8_t stream_run = 0;        // tags completions of this run
+static bool stream_start_acked = false;
+static uint32_t stream_seq = 0;
+static uint32_t stream_acked = 0;
+static uint32_t stream_started_ms = 0;
+static uint32_t control_sent_ms = 0;
+static uint8_t control_tries = 0;
+
+// Receiver
+static bool rx_active = false;
+static uint32_t rx_next_seq = 0;
+static uint32_t rx_first_ms = 0;
+static uint32_t rx_last_ms = 0;
+
+static uint32_t cycles_to_us(uint32_t cycles) {
+  return cycles / (SystemCoreClock / 1000000);
+}
+
+static uint32_t hist_percentile(uint16_t permille) {
+  uint32_t target = ((uint32_t)ping.received * permille + 999) / 1000;
+  uint32_t seen = 0;
+
+  for (uint8_t bin = 0; bin < KLBN_RADIO_BENCH_HIST_BINS; bin++) {
+    seen += rtt_hist[bin];
+    if (seen >= target) {
+      uint32_t edge = (uint32_t)(bin + 1) * KLBN_RADIO_BENCH_HIST_BIN_US;
+      return (edge < ping.max_us) ? edge : ping.max_us;
+    }
+  }
+  return ping.max_us;
+}
+
+// Derived figures, published in one go for the readers in other tasks
+static void publish(klbn_radio_bench_state_t state) {
+  uint32_t avg = ping.received ? rtt_sum_us / ping.received : 0;
+  uint32_t p50 = ping.received ? hist_percentile(500) : 0;
+  uint32_t p99 = ping.received ? hist_percentile(990) : 0;
+
+  taskENTER_CRITICAL();
+  ping.avg_us = avg;
+  ping.p50_us = p50;
+  ping.p99_us = p99;
+  ping.state = state;
+  taskEXIT_CRITICAL();
+}
+
+static void ping_start(void) {
+  for (uint8_t i = 0; i < KLBN_RADIO_BENCH_HIST_BINS; i++) {
+    rtt_hist[i] = 0;
+  }
+
+  taskENTER_CRITICAL();
+  ping.sent = ping.received = ping.lost = 0;
+  ping.min_us = UINT32_MAX;
+  ping.max_us = 0;
+  taskEXIT_CRITICAL();
+
+  rtt_sum_us = 0;
+  probe_outstanding = false;
+  publish(KLBN_RADIO_BENCH_RUNNING);
+}
+
+static void send_probe(uint32_t now_ms) {
+  uint32_t stamp = DWT->CYCCNT;
+  uint8_t payload[BENCH_PROBE_SIZE] = {
+      BENCH_OP_PING,
+      (uint8_t)probe_seq,
+      (uint8_t)(probe_seq >> 8),
+      (uint8_t)stamp,
+      (uint8_t)(stamp >> 8),
+      (uint8_t)(stamp >> 16),
+      (uint8_t)(stamp >> 24),
+  };
+
+  if (klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_BENCH, payload,
+                                BENCH_PROBE_SIZE, NULL, NULL)) {
+    probe_outstanding = true;
+    probe_sent_ms = now_ms;
+    ping.sent++;
+  }
+}
+
+static void ping_update(uint32_t now_ms) {
+  if (probe_outstanding) {
+    if ((now_ms - probe_sent_ms) < KLBN_RADIO_BENCH_PING_TIMEOUT_MS) {
+      return;
+    }
+    // A late echo of this probe no longer matches probe_seq
+    probe_outstanding = false;
+    probe_seq++;
+    ping.lost++;
+  }
+
+  if (ping.sent >= KLBN_RADIO_BENCH_PING_PROBES) {
+    publish(KLBN_RADIO_BENCH_DONE);
+    return;
+  }
+
+  if ((now_ms - probe_sent_ms) >= KLBN_RADIO_BENCH_PING_INTERVAL_MS) {
+    send_probe(now_ms);
+  }
+}
+
+static void handle_pong(const uint8_t *payload) {
+  uint32_t now = DWT->CYCCNT;
+  uint16_t seq = payload[1] | ((uint16_t)payload[2] << 8);
+  uint32_t stamp = payload[3] | ((uint32_t)payload[4] << 8) |
+                   ((uint32_t)payload[5] << 16) | ((uint32_t)payload[6] << 24);
+
+  if (ping.state != KLBN_RADIO_BENCH_RUNNING || !probe_outstanding ||
+      seq != probe_seq) {
+    return;
+  }
+
+  // Both stamps come from our own cycle counter, no clock sync needed
+  uint32_t rtt_us = cycles_to_us(now - stamp);
+  uint32_t bin = rtt_us / KLBN_RADIO_BENCH_HIST_BIN_US;
+  if (bin >= KLBN_RADIO_BENCH_HIST_BINS) {
+    bin = KLBN_RADIO_BENCH_HIST_BINS - 1;
+  }
+  rtt_hist[bin]++;
+  rtt_sum_us += rtt_us;
+
+  taskENTER_CRITICAL();
+  ping.received++;
+  if (rtt_us < ping.min_us) {
+    ping.min_us = rtt_us;
+  }
+  if (rtt_us > ping.max_us) {
+    ping.max_us = rtt_us;
+  }
+  taskEXIT_CRITICAL();
+
+  probe_outstanding = false;
+  probe_seq++;
+}
+
+static uint32_t goodput_kbps(uint32_t bytes, uint32_t ms) {
+  // Bits per millisecond is kbit/s
+  return ms ? bytes * 8 / ms : 0;
+}
+
+static void stream_finish(void) {
+  taskENTER_CRITICAL();
+  stream.state = KLBN_RADIO_BENCH_DONE;
+  taskEXIT_CRITICAL();
+  klbn_radio_rate_enable(true);
+}
+
+static void stream_tx_complete(klbn_radio_tx_result_t result,
+                               uint8_t retransmits, void *context) {
+  (void)retransmits;
+
+  if ((uint8_t)(uintptr_t)context != stream_run) {
+    return;
+  }
+
+  if (result == KLBN_RADIO_TX_OK) {
+    stream_acked++;
+  }
+}
+
+static void start_tx_complete(klbn_radio_tx_result_t result,
+                              uint8_t retransmits, void *context) {
+  (void)retransmits;
+
+  if ((uint8_t)(uintptr_t)context == stream_run &&
+      result == KLBN_RADIO_TX_OK) {
+    stream_start_acked = true;
+  }
+}
+
+static void stream_start(uint32_t now_ms) {
+  stream_run++;
+  stream_phase = STREAM_PHASE_START;
+  stream_start_acked = false;
+  stream_seq = 0;
+  stream_acked = 0;
+  control_tries = 0;
+  control_sent_ms = now_ms - BENCH_CONTROL_RETRY_MS;
+
+  // Hold the data rate, one run measures one configuration
+  klbn_radio_rate_enable(false);
+
+  taskENTER_CRITICAL();
+  stream.state = KLBN_RADIO_BENCH_RUNNING;
+  stream.sender = true;
+  stream.no_ack = stream_no_ack;
+  stream.reliable = stream_reliable;
+  stream.payload_size = stream_payload_size;
+  if (stream_reliable && stream.payload_size > KLBN_RADIO_HUB_RELIABLE_MAX) {
+    stream.payload_size = KLBN_RADIO_HUB_RELIABLE_MAX;
+  }
+  stream.rate_level = klbn_radio_rate_get_level();
+  stream.duration_ms = KLBN_RADIO_BENCH_STREAM_MS;
+  stream.packets = stream.bytes = stream.kbps = 0;
+  stream.duplicates = stream.gaps = 0;
+  stream.peer_bytes = stream.peer_kbps = 0;
+  taskEXIT_CRITICAL();
+}
+
+static bool stream_queue(const klbn_radio_command_t *cmd) {
+  if (stream.reliable) {
+    // Waits for room rather than counting bulk drops against the class
+    return klbn_radio_sched_room(KLBN_RADIO_CLASS_BULK) > 0 &&
+           klbn_radio_sched_enqueue(cmd, KLBN_RADIO_CLASS_BULK);
+  }
+
+  return stream.no_ack ? klbn_radio_hub_broadcast(cmd, 0)
+                       : klbn_radio_hub_send_async(cmd, stream_tx_complete,
+                                                   (void *)(uintptr_t)stream_run);
+}
+
+// Keeps the radio queue, or on the reliable path the bulk class queue,
+// full: the hub takes what the chip can send
+static void stream_fill(void) {
+  klbn_radio_command_t cmd;
+
+  cmd.length = stream.payload_size;
+  cmd.data[0] = BENCH_STREAM_MARKER;
+  for (uint8_t i = KLBN_RADIO_BENCH_STREAM_MIN_PAYLOAD; i < cmd.length; i++) {
+    cmd.data[i] = i;
+  }
+
+  for (;;) {
+    cmd.data[1] = (uint8_t)stream_seq;
+    cmd.data[2] = (uint8_t)(stream_seq >> 8);
+    cmd.data[3] = (uint8_t)(stream_seq >> 16);
+    cmd.data[4] = (uint8_t)(stream_seq >> 24);
+
+    if (!stream_queue(&cmd)) {
+      return;
+    }
+    stream_seq++;
+  }
+}
+
+// Everything handed over has left the radio; on the reliable path it has
+// also left the class queue and the partial batch, and been acknowledged
+// or given up on by the ARQ
+static bool stream_drained(uint32_t now_ms) {
+  if (!klbn_nrf24l01_module_tx_idle()) {
+    return false;
+  }
+
+  if (!stream.reliable) {
+    return true;
+  }
+
+  // With the window open, a batch that is not due has no records
+  return klbn_radio_sched_room(KLBN_RADIO_CLASS_BULK) ==
+             KLBN_RADIO_SCHED_BULK_DEPTH &&
+         klbn_radio_arq_room(false) ==
+             KLBN_RADIO_ARQ_WINDOW - KLBN_RADIO_ARQ_URGENT_SLOTS &&
+         klbn_radio_batch_next_ms(now_ms) == UINT32_MAX;
+}
+
+static void stream_update(uint32_t now_ms) {
+  bool resend = (now_ms - control_sent_ms) >= BENCH_CONTROL_RETRY_MS;
+
+  switch (stream_phase) {
+  case STREAM_PHASE_START:
+    if (stream_start_acked) {
+      stream_started_ms = now_ms;
+      stream_phase = STREAM_PHASE_SEND;
+    } else if (resend) {
+      if (control_tries++ >= BENCH_CONTROL_TRIES) {
+        // No peer
+        stream_finish();
+        return;
+      }
+      uint8_t payload[BENCH_START_SIZE] = {BENCH_OP_START, stream.payload_size,
+                                           stream.no_ack, stream.reliable};
+      klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_BENCH, payload,
+                                BENCH_START_SIZE, start_tx_complete,
+                                (void *)(uintptr_t)stream_run);
+      control_sent_ms = now_ms;
+    }
+    break;
+
+  case STREAM_PHASE_SEND:
+    if ((now_ms - stream_started_ms) >= KLBN_RADIO_BENCH_STREAM_MS) {
+      stream_phase = STREAM_PHASE_DRAIN;
+      break;
+    }
+    stream_fill();
+    break;
+
+  case STREAM_PHASE_DRAIN:
+    if (stream_drained(now_ms) ||
+        (now_ms - stream_started_ms) >=
+            KLBN_RADIO_BENCH_STREAM_MS + BENCH_DRAIN_MS) {
+      // Without ACKs all we know is what went out. The ARQ acknowledges
+      // batches, not records, so the reliable path leaves the exact figure
+      // to the peer's report.
+      uint32_t delivered =
+          (stream.no_ack || stream.reliable) ? stream_seq : stream_acked;
+      uint32_t bytes = delivered * stream.payload_size;
+
+      taskENTER_CRITICAL();
+      stream.packets = stream_seq;
+      stream.bytes = bytes;
+      stream.kbps = goodput_kbps(bytes, KLBN_RADIO_BENCH_STREAM_MS);
+      taskEXIT_CRITICAL();
+
+      stream_phase = STREAM_PHASE_END;
+      control_tries = 0;
+      control_sent_ms = now_ms - BENCH_CONTROL_RETRY_MS;
+    }
+    break;
+
+  case STREAM_PHASE_END:
+    if (resend) {
+      if (control_tries++ >= BENCH_CONTROL_TRIES) {
+        // Our own figures stand, the peer's stay at zero
+        stream_finish();
+        return;
+      }
+      uint8_t payload[BENCH_END_SIZE] = {
+          BENCH_OP_END, (uint8_t)stream_seq, (uint8_t)(stream_seq >> 8),
+          (uint8_t)(stream_seq >> 16), (uint8_t)(stream_seq >> 24)};
+      klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_BENCH, payload,
+                                BENCH_END_SIZE, NULL, NULL);
+      control_sent_ms = now_ms;
+    }
+    break;
+  }
+}
+
+static void rx_start(const uint8_t *payload) {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  klbn_radio_rate_enable(false);
+  last_mode = KLBN_RADIO_BENCH_STREAM;
+  rx_active = true;
+  rx_next_seq = 0;
+  rx_first_ms = rx_last_ms = now_ms;
+
+  taskENTER_CRITICAL();
+  stream.state = KLBN_RADIO_BENCH_RUNNING;
+  stream.sender = false;
+  stream.payload_size = payload[1];
+  stream.no_ack = payload[2] != 0;
+  stream.reliable = payload[3] != 0;
+  stream.rate_level = klbn_radio_rate_get_level();
+  stream.duration_ms = 0;
+  stream.packets = stream.bytes = stream.kbps = 0;
+  stream.duplicates = stream.gaps = 0;
+  stream.peer_bytes = stream.peer_kbps = 0;
+  taskEXIT_CRITICAL();
+}
+
+static void rx_finish(void) {
+  uint32_t elapsed = rx_last_ms - rx_first_ms;
+
+  rx_active = false;
+  taskENTER_CRITICAL();
+  stream.duration_ms = elapsed;
+  stream.kbps = goodput_kbps(stream.bytes, elapsed);
+  taskEXIT_CRITICAL();
+  stream_finish();
+}
+
+static void put_u32(uint8_t *out, uint32_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+  return in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+         ((uint32_t)in[3] << 24);
+}
+
+static void rx_end(const uint8_t *payload) {
+  uint8_t report[BENCH_REPORT_SIZE];
+
+  // Whatever the sender handed over but never showed up
+  uint32_t sent = get_u32(&payload[1]);
+  if (rx_active && sent > rx_next_seq) {
+    stream.gaps += sent - rx_next_seq;
+  }
+
+  // A repeated END, our REPORT was lost: send the same one again
+  if (rx_active) {
+    rx_finish();
+  } else if (stream.sender || stream.state != KLBN_RADIO_BENCH_DONE) {
+    return;
+  }
+
+  report[0] = BENCH_OP_REPORT;
+  put_u32(&report[1], stream.bytes);
+  put_u32(&report[5], stream.duplicates);
+  put_u32(&report[9], stream.gaps);
+  put_u32(&report[13], stream.duration_ms);
+  klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_BENCH, report, BENCH_REPORT_SIZE,
+                            NULL, NULL);
+}
+
+static void tx_report(const uint8_t *payload) {
+  if (!stream.sender || stream.state != KLBN_RADIO_BENCH_RUNNING ||
+      stream_phase != STREAM_PHASE_END) {
+    return;
+  }
+
+  uint32_t bytes = get_u32(&payload[1]);
+  uint32_t elapsed = get_u32(&payload[13]);
+
+  taskENTER_CRITICAL();
+  stream.peer_bytes = bytes;
+  stream.duplicates = get_u32(&payload[5]);
+  stream.gaps = get_u32(&payload[9]);
+  stream.peer_kbps = goodput_kbps(bytes, elapsed);
+  taskEXIT_CRITICAL();
+  stream_finish();
+}
+
+void klbn_radio_bench_init(void) {
+  requested = KLBN_RADIO_BENCH_NONE;
+  ping.state = KLBN_RADIO_BENCH_IDLE;
+  stream.state = KLBN_RADIO_BENCH_IDLE;
+}
+
+void klbn_radio_bench_request(klbn_radio_bench_mode_t mode) {
+  requested = mode;
+}
+
+void klbn_radio_bench_configure_stream(uint8_t payload_size, bool no_ack,
+                                       bool reliable) {
+  uint8_t max = reliable ? KLBN_RADIO_HUB_RELIABLE_MAX
+                         : KLBN_RADIO_FRAME_MAX_PAYLOAD;
+
+  if (payload_size < KLBN_RADIO_BENCH_STREAM_MIN_PAYLOAD ||
+      payload_size > max) {
+    return;
+  }
+
+  stream_payload_size = payload_size;
+  stream_no_ack = no_ack;
+  stream_reliable = reliable;
+}
+
+void klbn_radio_bench_update(uint32_t now_ms) {
+  klbn_radio_bench_mode_t mode = requested;
+  bool busy = ping.state == KLBN_RADIO_BENCH_RUNNING ||
+              stream.state == KLBN_RADIO_BENCH_RUNNING;
+
+  // One run at a time, a request while busy waits for the current one
+  if (mode != KLBN_RADIO_BENCH_NONE && !busy) {
+    requested = KLBN_RADIO_BENCH_NONE;
+    last_mode = mode;
+    if (mode == KLBN_RADIO_BENCH_PING) {
+      ping_start();
+    } else if (mode == KLBN_RADIO_BENCH_STREAM) {
+      stream_start(now_ms);
+    }
+  }
+
+  if (ping.state == KLBN_RADIO_BENCH_RUNNING) {
+    ping_update(now_ms);
+  }
+
+  if (stream.state == KLBN_RADIO_BENCH_RUNNING) {
+    if (stream.sender) {
+      stream_update(now_ms);
+    } else if ((now_ms - rx_last_ms) >= BENCH_RX_IDLE_MS) {
+      rx_finish();
+    }
+  }
+}
+
+void klbn_radio_bench_handle_frame(const uint8_t *payload, uint8_t length) {
+  static const uint8_t op_size[] = {
+      [BENCH_OP_PING] = BENCH_PROBE_SIZE, [BENCH_OP_PONG] = BENCH_PROBE_SIZE,
+      [BENCH_OP_START] = BENCH_START_SIZE, [BENCH_OP_END] = BENCH_END_SIZE,
+      [BENCH_OP_REPORT] = BENCH_REPORT_SIZE,
+  };
+
+  if (!payload || length == 0 || payload[0] == 0 ||
+      payload[0] >= sizeof(op_size) || length < op_size[payload[0]]) {
+    return;
+  }
+
+  switch ((bench_op_t)payload[0]) {
+  case BENCH_OP_PING: {
+    // Echo straight from the drain, queueing delay is part of the RTT
+    uint8_t echo[BENCH_PROBE_SIZE];
+    for (uint8_t i = 0; i < BENCH_PROBE_SIZE; i++) {
+      echo[i] = payload[i];
+    }
+    echo[0] = BENCH_OP_PONG;
+    klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_BENCH, echo, BENCH_PROBE_SIZE,
+                              NULL, NULL);
+    break;
+  }
+
+  case BENCH_OP_PONG:
+    handle_pong(payload);
+    break;
+
+  case BENCH_OP_START:
+    if (payload[1] >= KLBN_RADIO_BENCH_STREAM_MIN_PAYLOAD &&
+        !(stream.sender && stream.state == KLBN_RADIO_BENCH_RUNNING)) {
+      rx_start(payload);
+    }
+    break;
+
+  case BENCH_OP_END:
+    rx_end(payload);
+    break;
+
+  case BENCH_OP_REPORT:
+    tx_report(payload);
+    break;
+
+  default:
+    break;
+  }
+}
+
+bool klbn_radio_bench_consume(const klbn_radio_data_t *data) {
+  if (!rx_active || !data || data->length < KLBN_RADIO_BENCH_STREAM_MIN_PAYLOAD ||
+      data->data[0] != BENCH_STREAM_MARKER) {
+    return false;
+  }
+
+  uint32_t seq = get_u32(&data->data[1]);
+  rx_last_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  taskENTER_CRITICAL();
+  if (seq < rx_next_seq) {
+    // Resent after its ACK was lost
+    stream.duplicates++;
+  } else {
+    if (stream.packets == 0) {
+      rx_first_ms = rx_last_ms;
+    }
+    stream.gaps += seq - rx_next_seq;
+    stream.packets++;
+    stream.bytes += data->length;
+    rx_next_seq = seq + 1;
+  }
+  taskEXIT_CRITICAL();
+  return true;
+}
+
+void klbn_radio_bench_get_ping(klbn_radio_bench_ping_result_t *out) {
+  if (!out) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  *out = ping;
+  taskEXIT_CRITICAL();
+}
+
+void klbn_radio_bench_get_stream(klbn_radio_bench_stream_result_t *out) {
+  if (!out) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  *out = stream;
+  taskEXIT_CRITICAL();
+}
+
+klbn_radio_bench_mode_t klbn_radio_bench_get_mode(void) {
+  return last_mode;
+}
+
+static uint32_t time_left(uint32_t since_ms, uint32_t period_ms,
+                          uint32_t now_ms) {
+  uint32_t waited = now_ms - since_ms;
+  return (waited >= period_ms) ? 0 : period_ms - waited;
+}
+
+uint32_t klbn_radio_bench_next_ms(uint32_t now_ms) {
+  uint32_t next = UINT32_MAX;
+
+  if (requested != KLBN_RADIO_BENCH_NONE) {
+    return 0;
+  }
+
+  if (ping.state == KLBN_RADIO_BENCH_RUNNING) {
+    next = probe_outstanding
+               ? time_left(probe_sent_ms, KLBN_RADIO_BENCH_PING_TIMEOUT_MS,
+                           now_ms)
+               : time_left(probe_sent_ms, KLBN_RADIO_BENCH_PING_INTERVAL_MS,
+                           now_ms);
+  }
+
+  if (stream.state == KLBN_RADIO_BENCH_RUNNING) {
+    uint32_t left;
+
+    if (!stream.sender) {
+      left = time_left(rx_last_ms, BENCH_RX_IDLE_MS, now_ms);
+    } else if (stream_phase == STREAM_PHASE_SEND) {
+      // Refills ride on TX completions (ARQ_ACKs on the reliable path),
+      // the clock only ends the run
+      left = time_left(stream_started_ms, KLBN_RADIO_BENCH_STREAM_MS, now_ms);
+    } else if (stream_phase == STREAM_PHASE_DRAIN) {
+      left = time_left(stream_started_ms,
+                       KLBN_RADIO_BENCH_STREAM_MS + BENCH_DRAIN_MS, now_ms);
+    } else {
+      left = stream_start_acked
+                 ? 0
+                 : time_left(control_sent_ms, BENCH_CONTROL_RETRY_MS, now_ms);
+    }
+
+    if (left < next) {
+      next = left;
+    }
+  }
+
+  return next;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_frag.h"
+#include "klbn_radio_hub.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_link_stats.h"
+#include "klbn_rtos.h"
+
+#include <stdint.h>
+
+#define FRAG_TX_RETRIES 8   // failed fragment sends before giving up
+
+typedef struct {
+  bool used;
+  uint8_t pipe;
+  uint8_t id;
+  uint8_t count;
+  uint16_t received;  // bit n: fragment n is in
+  uint16_t length;    // known once the last fragment is in
+  uint32_t last_ms;
+  uint8_t data[KLBN_RADIO_FRAG_MAX_MESSAGE];
+} frag_slot_t;
+
+// Outgoing messages wait here, whole, until the hub task takes them
+static MessageBufferHandle_t tx_buffer = NULL;
+#ifdef KLBN_STATIC_ALLOCATION
+static uint8_t tx_buffer_storage[KLBN_RADIO_FRAG_TX_BUFFER + 1];
+static StaticMessageBuffer_t tx_buffer_struct;
+#endif
+
+// Message being sent
+static uint8_t tx_data[KLBN_RADIO_FRAG_MAX_MESSAGE];
+static uint16_t tx_length = 0;
+static uint8_t tx_count = 0;
+static uint8_t tx_id = 0;
+static uint16_t tx_queued = 0;   // handed to the radio (or acked)
+static uint16_t tx_acked = 0;
+static uint8_t tx_failures = 0;
+static bool tx_active = false;
+
+static frag_slot_t rx_slots[KLBN_RADIO_FRAG_SLOTS];
+
+// Last message delivered per pipe, to drop its late duplicates
+static uint8_t last_completed[KLBN_RADIO_LINK_COUNT];
+static uint32_t last_completed_ms[KLBN_RADIO_LINK_COUNT];
+static bool last_completed_valid[KLBN_RADIO_LINK_COUNT];
+
+static klbn_radio_frag_handler_t frag_handler = NULL;
+static void *frag_context = NULL;
+static uint32_t dropped = 0;
+
+static uint16_t all_fragments(uint8_t count) {
+  return (uint16_t)((1UL << count) - 1);
+}
+
+static void frag_tx_complete(klbn_radio_tx_result_t result,
+                             uint8_t retransmits, void *context) {
+  (void)retransmits;
+  uintptr_t tag = (uintptr_t)context;
+  uint16_t bit = 1U << (tag & 0xFF);
+
+  // A fragment of a message already finished or abandoned
+  if (!tx_active || (uint8_t)(tag >> 8) != tx_id) {
+    return;
+  }
+
+  if (result == KLBN_RADIO_TX_OK) {
+    tx_acked |= bit;
+    if (tx_acked == all_fragments(tx_count)) {
+      tx_active = false;
+    }
+    return;
+  }
+
+  // Hand it back to the pump for another try
+  tx_queued &= ~bit;
+  if (++tx_failures > FRAG_TX_RETRIES) {
+    tx_active = false;
+    dropped++;
+  }
+}
+
+static void pump_fragments(void) {
+  for (uint8_t index = 0; index < tx_count; index++) {
+    uint16_t bit = 1U << index;
+    uint8_t payload[KLBN_RADIO_FRAG_HEADER_SIZE + KLBN_RADIO_FRAG_PAYLOAD];
+
+    if (tx_queued & bit) {
+      continue;
+    }
+
+    uint16_t offset = (uint16_t)index * KLBN_RADIO_FRAG_PAYLOAD;
+    uint8_t length = (tx_length - offset > KLBN_RADIO_FRAG_PAYLOAD)
+                         ? KLBN_RADIO_FRAG_PAYLOAD
+                         : (uint8_t)(tx_length - offset);
+
+    payload[0] = tx_id;
+    payload[1] = index;
+    payload[2] = tx_count;
+    for (uint8_t i = 0; i < length; i++) {
+      payload[KLBN_RADIO_FRAG_HEADER_SIZE + i] = tx_data[offset + i];
+    }
+
+    uintptr_t tag = ((uintptr_t)tx_id << 8) | index;
+    if (!klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_FRAG, payload,
+                                   KLBN_RADIO_FRAG_HEADER_SIZE + length,
+                                   frag_tx_complete, (void *)tag)) {
+      // Radio queue full, continue on the next pass
+      return;
+    }
+    tx_queued |= bit;
+  }
+}
+
+static frag_slot_t *find_slot(uint8_t pipe, uint8_t id, uint8_t count) {
+  frag_slot_t *free_slot = NULL;
+  frag_slot_t *oldest = &rx_slots[0];
+
+  for (uint8_t i = 0; i < KLBN_RADIO_FRAG_SLOTS; i++) {
+    frag_slot_t *slot = &rx_slots[i];
+
+    if (!slot->used) {
+      if (!free_slot) {
+        free_slot = slot;
+      }
+      continue;
+    }
+    if (slot->pipe == pipe && slot->id == id && slot->count == count) {
+      return slot;
+    }
+    if ((int32_t)(slot->last_ms - oldest->last_ms) < 0) {
+      oldest = slot;
+    }
+  }
+
+  // All slots busy, the stalest message loses
+  if (!free_slot) {
+    free_slot = oldest;
+    dropped++;
+  }
+
+  free_slot->used = true;
+  free_slot->pipe = pipe;
+  free_slot->id = id;
+  free_slot->count = count;
+  free_slot->received = 0;
+  free_slot->length = 0;
+  return free_slot;
+}
+
+void klbn_radio_frag_init(void) {
+  if (tx_buffer == NULL) {
+    tx_buffer = KLBN_MESSAGE_BUFFER_CREATE(KLBN_RADIO_FRAG_TX_BUFFER,
+                                           tx_buffer_storage,
+                                           &tx_buffer_struct);
+  }
+
+  for (uint8_t i = 0; i < KLBN_RADIO_FRAG_SLOTS; i++) {
+    rx_slots[i].used = false;
+  }
+  for (uint8_t i = 0; i < KLBN_RADIO_LINK_COUNT; i++) {
+    last_completed_valid[i] = false;
+  }
+  tx_active = false;
+}
+
+void klbn_radio_frag_set_handler(klbn_radio_frag_handler_t handler,
+                                 void *context) {
+  frag_handler = handler;
+  frag_context = context;
+}
+
+bool klbn_radio_frag_send(const uint8_t *data, uint16_t length,
+                          TickType_t wait) {
+  if (!data || length == 0 || length > KLBN_RADIO_FRAG_MAX_MESSAGE ||
+      tx_buffer == NULL) {
+    return false;
+  }
+
+  return xMessageBufferSend(tx_buffer, data, length, wait) == length;
+}
+
+void klbn_radio_frag_update(uint32_t now_ms) {
+  if (!tx_active && tx_buffer != NULL) {
+    size_t length = xMessageBufferReceive(tx_buffer, tx_data, sizeof(tx_data), 0);
+
+    if (length > 0) {
+      tx_length = (uint16_t)length;
+      tx_count = (tx_length + KLBN_RADIO_FRAG_PAYLOAD - 1) / KLBN_RADIO_FRAG_PAYLOAD;
+      tx_id++;
+      tx_queued = 0;
+      tx_acked = 0;
+      tx_failures = 0;
+      tx_active = true;
+    }
+  }
+
+  if (tx_active) {
+    pump_fragments();
+  }
+
+  for (uint8_t i = 0; i < KLBN_RADIO_FRAG_SLOTS; i++) {
+    frag_slot_t *slot = &rx_slots[i];
+
+    if (slot->used && (now_ms - slot->last_ms) >= KLBN_RADIO_FRAG_TIMEOUT_MS) {
+      slot->used = false;
+      dropped++;
+    }
+  }
+}
+
+void klbn_radio_frag_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint8_t pipe, uint32_t now_ms) {
+  if (!payload || length <= KLBN_RADIO_FRAG_HEADER_SIZE ||
+      pipe >= KLBN_RADIO_LINK_COUNT) {
+    return;
+  }
+
+  uint8_t id = payload[0];
+  uint8_t index = payload[1];
+  uint8_t count = payload[2];
+  uint8_t size = length - KLBN_RADIO_FRAG_HEADER_SIZE;
+
+  // Every fragment but the last is full
+  if (count == 0 || count > KLBN_RADIO_FRAG_MAX_FRAGMENTS || index >= count ||
+      size > KLBN_RADIO_FRAG_PAYLOAD ||
+      (index + 1 < count && size != KLBN_RADIO_FRAG_PAYLOAD)) {
+    return;
+  }
+
+  // A fragment resent after its ACK was lost, for a message delivered.
+  // Only recent ones: a rebooted sender starts its ids over.
+  if (last_completed_valid[pipe] && last_completed[pipe] == id &&
+      (now_ms - last_completed_ms[pipe]) < KLBN_RADIO_FRAG_TIMEOUT_MS) {
+    return;
+  }
+
+  frag_slot_t *slot = find_slot(pipe, id, count);
+  uint16_t bit = 1U << index;
+
+  slot->last_ms = now_ms;
+  if (slot->received & bit) {
+    return;
+  }
+
+  uint16_t offset = (uint16_t)index * KLBN_RADIO_FRAG_PAYLOAD;
+  for (uint8_t i = 0; i < size; i++) {
+    slot->data[offset + i] = payload[KLBN_RADIO_FRAG_HEADER_SIZE + i];
+  }
+  slot->received |= bit;
+  if (index + 1 == count) {
+    slot->length = offset + size;
+  }
+
+  if (slot->received == all_fragments(count)) {
+    slot->used = false;
+    last_completed[pipe] = id;
+    last_completed_ms[pipe] = now_ms;
+    last_completed_valid[pipe] = true;
+
+    if (frag_handler) {
+      frag_handler(slot->data, slot->length, pipe, frag_context);
+    }
+  }
+}
+
+uint32_t klbn_radio_frag_get_dropped(void) {
+  return dropped;
+}
+
+uint32_t klbn_radio_frag_next_ms(uint32_t now_ms) {
+  uint32_t next = UINT32_MAX;
+
+  // A queued message starts on the next pass; fragments in flight are
+  // pumped again as their completions wake the hub
+  if (!tx_active && tx_buffer != NULL && !xMessageBufferIsEmpty(tx_buffer)) {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < KLBN_RADIO_FRAG_SLOTS; i++) {
+    const frag_slot_t *slot = &rx_slots[i];
+
+    if (slot->used) {
+      uint32_t waited = now_ms - slot->last_ms;
+      uint32_t left = (waited >= KLBN_RADIO_FRAG_TIMEOUT_MS)
+                          ? 0
+                          : KLBN_RADIO_FRAG_TIMEOUT_MS - waited;
+      if (left < next) {
+        next = left;
+      }
+    }
+  }
+
+  return next;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_hop.h"
+#include "klbn_radio_hub.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_link_stats.h"
+#include "klbn_radio_scan.h"
+#include "klbn_nrf24l01_module.h"
+
+#include <stdint.h>
+
+#define HOP_ANCHOR_PERIOD      8     // every 8th slot is on the anchor channel
+#define HOP_LOST_SLOTS         (3 * HOP_ANCHOR_PERIOD)  // no beacon: resync
+#define HOP_CHANNEL_SPACING    3     // default set, MHz between channels
+
+// Blacklisting, master side
+#define HOP_LOSS_SHIFT         2     // EWMA weight 1/4 per dwell
+#define HOP_MIN_ATTEMPTS       2     // sends in a dwell worth judging
+#define HOP_BLACKLIST_PERMILLE 300
+#define HOP_BLACKLIST_MS       30000 // retry a blacklisted channel after this
+#define HOP_MIN_ACTIVE         4     // never shrink the set below this
+
+// Beacon: slot (2), offset in slot (1), blacklist (2), seed (4), count (1),
+// channels (count)
+#define HOP_BEACON_HEADER      10
+
+static klbn_radio_hop_role_t hop_role = KLBN_RADIO_HOP_OFF;
+static uint8_t hop_channels[KLBN_RADIO_HOP_MAX_CHANNELS];
+static uint8_t hop_count = 0;
+static bool hop_custom_set = false;   // set by klbn_radio_hop_set_channels()
+static uint16_t hop_blacklist = 0;
+static uint32_t hop_seed = 0;
+static uint32_t hop_epoch_ms = 0;
+static uint16_t hop_slot = 0;
+static bool hop_synced = false;
+static uint32_t last_beacon_ms = 0;
+
+static uint16_t channel_loss[KLBN_RADIO_HOP_MAX_CHANNELS];     // permille
+static uint32_t blacklisted_at[KLBN_RADIO_HOP_MAX_CHANNELS];
+static klbn_radio_link_counters_t dwell_snapshot;
+
+static uint32_t hop_mix(uint32_t x) {
+  x *= 0x9E3779B1UL;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static uint8_t active_count(void) {
+  uint8_t active = 0;
+
+  for (uint8_t i = 0; i < hop_count; i++) {
+    if (!(hop_blacklist & (1U << i))) {
+      active++;
+    }
+  }
+  return active;
+}
+
+// Same seed, set and blacklist give the same sequence on both ends
+static uint8_t slot_channel_index(uint16_t slot) {
+  uint8_t active = active_count();
+
+  if (slot % HOP_ANCHOR_PERIOD == 0 || active == 0) {
+    return 0;
+  }
+
+  uint8_t pick = hop_mix(hop_seed ^ slot) % active;
+  for (uint8_t i = 0; i < hop_count; i++) {
+    if (hop_blacklist & (1U << i)) {
+      continue;
+    }
+    if (pick-- == 0) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+static uint16_t current_slot(uint32_t now_ms) {
+  return (uint16_t)((now_ms - hop_epoch_ms) / KLBN_RADIO_HOP_DWELL_MS);
+}
+
+// Quietest channels from the boot sweep, spread apart, anchored on the
+// channel the rendezvous settled on
+static void build_default_set(void) {
+  hop_channels[0] = klbn_nrf24l01_module_get_channel();
+  channel_loss[0] = 0;
+  hop_count = 1;
+  hop_blacklist = 0;
+
+  while (hop_count < KLBN_RADIO_HOP_MAX_CHANNELS) {
+    uint8_t best = 0xFF;
+    uint8_t best_level = 0xFF;
+
+    for (uint8_t ch = 0; ch < KLBN_RADIO_SCAN_CHANNELS; ch++) {
+      bool too_close = false;
+      for (uint8_t i = 0; i < hop_count; i++) {
+        int16_t gap = (int16_t)ch - hop_channels[i];
+        if (gap < HOP_CHANNEL_SPACING && gap > -HOP_CHANNEL_SPACING) {
+          too_close = true;
+          break;
+        }
+      }
+
+      uint8_t level = klbn_radio_scan_get_occupancy(ch);
+      if (!too_close && level < best_level) {
+        best = ch;
+        best_level = level;
+      }
+    }
+
+    if (best == 0xFF) {
+      break;
+    }
+    channel_loss[hop_count] = 0;
+    hop_channels[hop_count++] = best;
+  }
+}
+
+// Attribute the last dwell's sends to the channel it was spent on
+static void account_dwell(uint8_t index, uint32_t now_ms) {
+  klbn_radio_link_counters_t now;
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_TX, &now);
+
+  uint32_t acked = now.acked - dwell_snapshot.acked;
+  uint32_t lost = now.lost - dwell_snapshot.lost;
+  dwell_snapshot = now;
+
+  if (acked + lost < HOP_MIN_ATTEMPTS) {
+    return;
+  }
+
+  int32_t sample = (int32_t)(lost * 1000 / (acked + lost));
+  int32_t delta = sample - (int32_t)channel_loss[index];
+  channel_loss[index] =
+      (uint16_t)((int32_t)channel_loss[index] + delta / (1 << HOP_LOSS_SHIFT));
+
+  // The anchor stays in, slaves resync on it
+  if (index != 0 && channel_loss[index] > HOP_BLACKLIST_PERMILLE &&
+      active_count() > HOP_MIN_ACTIVE) {
+    hop_blacklist |= 1U << index;
+    blacklisted_at[index] = now_ms;
+  }
+}
+
+static void expire_blacklist(uint32_t now_ms) {
+  for (uint8_t i = 0; i < hop_count; i++) {
+    if ((hop_blacklist & (1U << i)) &&
+        (now_ms - blacklisted_at[i]) >= HOP_BLACKLIST_MS) {
+      hop_blacklist &= ~(1U << i);
+      channel_loss[i] = 0;
+    }
+  }
+}
+
+static void send_beacon(uint32_t now_ms) {
+  uint8_t payload[HOP_BEACON_HEADER + KLBN_RADIO_HOP_MAX_CHANNELS];
+  uint8_t offset = (now_ms - hop_epoch_ms) % KLBN_RADIO_HOP_DWELL_MS;
+
+  payload[0] = hop_slot & 0xFF;
+  payload[1] = hop_slot >> 8;
+  payload[2] = offset;
+  payload[3] = hop_blacklist & 0xFF;
+  payload[4] = hop_blacklist >> 8;
+  payload[5] = hop_seed & 0xFF;
+  payload[6] = (hop_seed >> 8) & 0xFF;
+  payload[7] = (hop_seed >> 16) & 0xFF;
+  payload[8] = hop_seed >> 24;
+  payload[9] = hop_count;
+  for (uint8_t i = 0; i < hop_count; i++) {
+    payload[HOP_BEACON_HEADER + i] = hop_channels[i];
+  }
+
+  klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_HOP, payload,
+                            HOP_BEACON_HEADER + hop_count, NULL, NULL);
+}
+
+static void park(void) {
+  hop_synced = false;
+  if (hop_count > 0) {
+    klbn_nrf24l01_module_set_channel(hop_channels[0]);
+  }
+}
+
+bool klbn_radio_hop_set_channels(const uint8_t *channels, uint8_t count) {
+  if (!channels || count == 0 || count > KLBN_RADIO_HOP_MAX_CHANNELS) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (channels[i] >= KLBN_RADIO_SCAN_CHANNELS) {
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    hop_channels[i] = channels[i];
+    channel_loss[i] = 0;
+  }
+  hop_count = count;
+  hop_blacklist = 0;
+  hop_custom_set = true;
+  return true;
+}
+
+void klbn_radio_hop_start(klbn_radio_hop_role_t role, uint32_t seed,
+                          uint32_t now_ms) {
+  hop_role = role;
+  hop_seed = seed;
+  hop_epoch_ms = now_ms;
+  hop_slot = 0;
+  last_beacon_ms = now_ms;
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_TX, &dwell_snapshot);
+
+  if (role == KLBN_RADIO_HOP_MASTER) {
+    // A rendezvous run again after link loss may have moved the anchor
+    if (!hop_custom_set) {
+      build_default_set();
+    }
+    hop_synced = true;
+    klbn_nrf24l01_module_set_channel(hop_channels[0]);
+    send_beacon(now_ms);
+  } else if (role == KLBN_RADIO_HOP_SLAVE) {
+    // Wait on the current channel, the master starts on the same anchor
+    hop_channels[0] = klbn_nrf24l01_module_get_channel();
+    hop_count = 1;
+    hop_synced = false;
+  }
+}
+
+void klbn_radio_hop_stop(void) {
+  hop_role = KLBN_RADIO_HOP_OFF;
+  hop_synced = false;
+}
+
+void klbn_radio_hop_update(uint32_t now_ms) {
+  if (hop_role == KLBN_RADIO_HOP_OFF) {
+    return;
+  }
+
+  if (hop_role == KLBN_RADIO_HOP_SLAVE && hop_synced &&
+      (now_ms - last_beacon_ms) >= HOP_LOST_SLOTS * KLBN_RADIO_HOP_DWELL_MS) {
+    park();
+  }
+
+  if (!hop_synced) {
+    return;
+  }
+
+  uint16_t slot = current_slot(now_ms);
+  if (slot == hop_slot) {
+    return;
+  }
+
+  // Never retune under a payload in flight; a late hop just joins the
+  // current slot
+  if (!klbn_nrf24l01_module_tx_idle()) {
+    return;
+  }
+
+  if (hop_role == KLBN_RADIO_HOP_MASTER) {
+    account_dwell(slot_channel_index(hop_slot), now_ms);
+    expire_blacklist(now_ms);
+  }
+
+  hop_slot = slot;
+  klbn_nrf24l01_module_set_channel(hop_channels[slot_channel_index(slot)]);
+
+  if (hop_role == KLBN_RADIO_HOP_MASTER) {
+    send_beacon(now_ms);
+  }
+}
+
+void klbn_radio_hop_handle_frame(const uint8_t *payload, uint8_t length,
+                                 uint32_t now_ms) {
+  if (hop_role != KLBN_RADIO_HOP_SLAVE || !payload ||
+      length < HOP_BEACON_HEADER) {
+    return;
+  }
+
+  uint8_t count = payload[9];
+  if (count == 0 || count > KLBN_RADIO_HOP_MAX_CHANNELS ||
+      length < HOP_BEACON_HEADER + count) {
+    return;
+  }
+
+  uint16_t slot = payload[0] | ((uint16_t)payload[1] << 8);
+  uint8_t offset = payload[2];
+
+  hop_blacklist = payload[3] | ((uint16_t)payload[4] << 8);
+  hop_seed = payload[5] | ((uint32_t)payload[6] << 8) |
+             ((uint32_t)payload[7] << 16) | ((uint32_t)payload[8] << 24);
+  hop_count = count;
+  for (uint8_t i = 0; i < count; i++) {
+    hop_channels[i] = payload[HOP_BEACON_HEADER + i];
+  }
+
+  // Line our slot clock up with the master's
+  hop_epoch_ms = now_ms - ((uint32_t)slot * KLBN_RADIO_HOP_DWELL_MS + offset);
+  hop_slot = slot;
+  hop_synced = true;
+  last_beacon_ms = now_ms;
+}
+
+bool klbn_radio_hop_synced(void) {
+  return hop_synced;
+}
+
+uint16_t klbn_radio_hop_get_blacklist(void) {
+  return hop_blacklist;
+}
+
+uint32_t klbn_radio_hop_next_ms(uint32_t now_ms) {
+  if (hop_role == KLBN_RADIO_HOP_OFF || !hop_synced) {
+    // An unsynced slave waits for a beacon, which arrives by IRQ
+    return UINT32_MAX;
+  }
+
+  uint32_t next = KLBN_RADIO_HOP_DWELL_MS -
+                  (now_ms - hop_epoch_ms) % KLBN_RADIO_HOP_DWELL_MS;
+
+  if (hop_role == KLBN_RADIO_HOP_SLAVE) {
+    uint32_t silent = now_ms - last_beacon_ms;
+    uint32_t lost = HOP_LOST_SLOTS * KLBN_RADIO_HOP_DWELL_MS;
+    uint32_t left = (silent >= lost) ? 0 : lost - silent;
+    if (left < next) {
+      next = left;
+    }
+  }
+
+  return next;
+}
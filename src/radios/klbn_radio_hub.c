@@ -9,10 +9,141 @@
 
 #include "klbn_radio_hub.h"
 #include "klbn_nrf24l01_module.h"
+#include "klbn_radio_arq.h"
+#include "klbn_radio_batch.h"
+#include "klbn_radio_bench.h"
+#include "klbn_radio_frag.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_hop.h"
+#include "klbn_radio_link_stats.h"
+#include "klbn_radio_rate.h"
+#include "klbn_radio_scan.h"
 #include "klbn_types.h"
+#include "task.h"
 
-void klbn_radio_hub_init(void) {
-  klbn_nrf24l01_module_init();
+// Longest the hub task sleeps: link statistics, rate windows and the
+// brownout check all run once a second
+#define HUB_MAX_SLEEP_MS 1000
+
+static SemaphoreHandle_t hub_wake = NULL;
+static uint32_t rx_dropped = 0;
+static bool scan_started = false;
+static bool hop_started = false;
+static bool bench_started = false;
+
+// Wraps the caller's handler while a drain splits control frames off
+typedef struct {
+  klbn_radio_rx_handler_t handler;
+  void *context;
+} hub_drain_t;
+
+static bool build_frame(uint8_t type, const uint8_t *payload, uint8_t length,
+                        klbn_radio_command_t *frame) {
+  if (length > KLBN_RADIO_FRAME_MAX_PAYLOAD || (length > 0 && !payload)) {
+    return false;
+  }
+
+  frame->data[0] = type;
+  for (uint8_t i = 0; i < length; i++) {
+    frame->data[KLBN_RADIO_FRAME_HEADER_SIZE + i] = payload[i];
+  }
+  frame->length = KLBN_RADIO_FRAME_HEADER_SIZE + length;
+  return true;
+}
+
+// Routes control frames to their owners and unwraps application data.
+// Returns true if the frame was application data, now in *data.
+static bool dispatch_frame(klbn_radio_data_t *data) {
+  if (data->length < KLBN_RADIO_FRAME_HEADER_SIZE) {
+    return false;
+  }
+
+  uint8_t type = data->data[0];
+  const uint8_t *payload = &data->data[KLBN_RADIO_FRAME_HEADER_SIZE];
+  uint8_t length = data->length - KLBN_RADIO_FRAME_HEADER_SIZE;
+
+  switch (type) {
+  case KLBN_RADIO_FRAME_DATA:
+    for (uint8_t i = 0; i < length; i++) {
+      data->data[i] = payload[i];
+    }
+    data->length = length;
+    return true;
+
+  case KLBN_RADIO_FRAME_RATE:
+    klbn_radio_rate_handle_frame(payload, length,
+                                 xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_SCAN:
+    klbn_radio_scan_handle_frame(payload, length,
+                                 xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_HOP:
+    klbn_radio_hop_handle_frame(payload, length,
+                                xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_FRAG:
+    klbn_radio_frag_handle_frame(payload, length, data->pipe,
+                                 xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_ARQ_DATA:
+    // Released in order, as records, by klbn_radio_batch_pop()
+    klbn_radio_arq_handle_data(payload, length, data->pipe,
+                               xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_ARQ_ACK:
+    klbn_radio_arq_handle_ack(payload, length,
+                              xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return false;
+
+  case KLBN_RADIO_FRAME_BENCH:
+    klbn_radio_bench_handle_frame(payload, length);
+    return false;
+
+  default:
+    // Unknown frame type, from a newer peer
+    return false;
+  }
+}
+
+static void deliver(const hub_drain_t *drain, const klbn_radio_data_t *frame) {
+  if (!drain->handler(frame, drain->context)) {
+    rx_dropped++;
+  }
+}
+
+static bool hub_frame_received(const klbn_radio_data_t *data, void *context) {
+  const hub_drain_t *drain = (const hub_drain_t *)context;
+  klbn_radio_data_t frame = *data;
+
+  // Benchmark stream traffic is counted, not delivered
+  if (dispatch_frame(&frame) && !klbn_radio_bench_consume(&frame)) {
+    deliver(drain, &frame);
+  }
+
+  // A reliable payload may have closed a gap in the sequence
+  while (klbn_radio_batch_pop(&frame)) {
+    if (!klbn_radio_bench_consume(&frame)) {
+      deliver(drain, &frame);
+    }
+  }
+  return true;
+}
+
+void klbn_radio_hub_init(SemaphoreHandle_t irq_signal) {
+  hub_wake = irq_signal;
+  klbn_radio_link_stats_init();
+  klbn_radio_rate_init();
+  klbn_radio_frag_init();
+  klbn_radio_arq_init();
+  klbn_radio_batch_init();
+  klbn_radio_bench_init();
+  klbn_nrf24l01_module_init(irq_signal);
 }
 
 bool klbn_radio_hub_receive(klbn_radio_data_t *out) {
@@ -20,13 +151,193 @@ bool klbn_radio_hub_receive(klbn_radio_data_t *out) {
     return false;
   }
 
-  return klbn_nrf24l01_module_receive(out);
+  for (;;) {
+    while (klbn_radio_batch_pop(out)) {
+      if (!klbn_radio_bench_consume(out)) {
+        return true;
+      }
+    }
+
+    if (!klbn_nrf24l01_module_receive(out)) {
+      return false;
+    }
+    if (dispatch_frame(out) && !klbn_radio_bench_consume(out)) {
+      return true;
+    }
+  }
+}
+
+uint8_t klbn_radio_hub_drain(klbn_radio_rx_handler_t handler, void *context) {
+  if (!handler) {
+    return 0;
+  }
+
+  hub_drain_t drain = {handler, context};
+  return klbn_nrf24l01_module_drain(hub_frame_received, &drain);
+}
+
+uint32_t klbn_radio_hub_rx_overflows(void) {
+  return klbn_nrf24l01_module_rx_overflows();
+}
+
+uint32_t klbn_radio_hub_rx_dropped(void) {
+  return rx_dropped;
+}
+
+bool klbn_radio_hub_send(const klbn_radio_command_t *cmd) {
+  return klbn_radio_hub_send_async(cmd, NULL, NULL);
+}
+
+bool klbn_radio_hub_send_async(const klbn_radio_command_t *cmd,
+                               klbn_radio_tx_callback_t callback,
+                               void *context) {
+  if (!cmd) {
+    return false;
+  }
+
+  return klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_DATA, cmd->data,
+                                   cmd->length, callback, context);
+}
+
+bool klbn_radio_hub_send_reliable(const klbn_radio_command_t *cmd) {
+  return klbn_radio_hub_send_reliable_urgent(cmd, false);
 }
 
-void klbn_radio_hub_send(const klbn_radio_command_t *cmd) {
+bool klbn_radio_hub_send_reliable_urgent(const klbn_radio_command_t *cmd,
+                                         bool urgent) {
   if (!cmd) {
-    return;
+    return false;
   }
 
-  klbn_nrf24l01_module_send(cmd);
-}
\ No newline at end of file
+  return klbn_radio_batch_add(cmd->data, cmd->length, urgent,
+                              xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+void klbn_radio_hub_set_batch_deadline(uint32_t deadline_ms) {
+  klbn_radio_batch_set_deadline(deadline_ms);
+}
+
+bool klbn_radio_hub_send_frame(uint8_t type, const uint8_t *payload,
+                               uint8_t length,
+                               klbn_radio_tx_callback_t callback,
+                               void *context) {
+  klbn_radio_command_t frame;
+
+  if (!build_frame(type, payload, length, &frame)) {
+    return false;
+  }
+
+  return klbn_nrf24l01_module_send_async(&frame, callback, context);
+}
+
+bool klbn_radio_hub_send_message(const uint8_t *data, uint16_t length,
+                                 TickType_t wait) {
+  if (!klbn_radio_frag_send(data, length, wait)) {
+    return false;
+  }
+
+  if (hub_wake != NULL) {
+    xSemaphoreGive(hub_wake);
+  }
+  return true;
+}
+
+void klbn_radio_hub_set_message_handler(klbn_radio_frag_handler_t handler,
+                                        void *context) {
+  klbn_radio_frag_set_handler(handler, context);
+}
+
+bool klbn_radio_hub_broadcast(const klbn_radio_command_t *cmd, uint8_t repeats) {
+  klbn_radio_command_t frame;
+
+  if (!cmd ||
+      !build_frame(KLBN_RADIO_FRAME_DATA, cmd->data, cmd->length, &frame)) {
+    return false;
+  }
+
+  return klbn_nrf24l01_module_broadcast(&frame, repeats);
+}
+
+bool klbn_radio_hub_queue_reply(uint8_t pipe, const klbn_radio_command_t *cmd) {
+  klbn_radio_command_t frame;
+
+  if (!cmd ||
+      !build_frame(KLBN_RADIO_FRAME_DATA, cmd->data, cmd->length, &frame)) {
+    return false;
+  }
+
+  return klbn_nrf24l01_module_queue_reply(pipe, &frame);
+}
+
+void klbn_radio_hub_service(void) {
+  klbn_nrf24l01_module_service();
+}
+
+bool klbn_radio_hub_irq_pending(void) {
+  return klbn_nrf24l01_module_irq_pending();
+}
+
+static void sooner(uint32_t *next, uint32_t ms) {
+  if (ms < *next) {
+    *next = ms;
+  }
+}
+
+uint32_t klbn_radio_hub_check(void) {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+  klbn_nrf24l01_module_check();
+
+  // Survey the band, then agree on a clean channel with the peer. The
+  // sweep blocks for its length, here rather than in the task setup.
+  if (!scan_started) {
+    klbn_radio_scan_start(now_ms);
+    scan_started = true;
+    now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  }
+
+  klbn_radio_link_stats_overflow(klbn_nrf24l01_module_rx_overflows());
+  klbn_radio_link_stats_update(now_ms);
+  klbn_radio_scan_update(now_ms);
+  klbn_radio_rate_update(now_ms);
+
+  // The link was lost and the rendezvous runs again on the boot channel
+  if (hop_started && !klbn_radio_scan_done()) {
+    klbn_radio_hop_stop();
+    hop_started = false;
+  }
+
+  // Hop from the channel the rendezvous picked, when built for it
+  if (!hop_started && KLBN_RADIO_HOP_ROLE != KLBN_RADIO_HOP_OFF &&
+      klbn_radio_scan_done()) {
+    klbn_radio_hop_start(KLBN_RADIO_HOP_ROLE, KLBN_RADIO_HOP_SEED, now_ms);
+    hop_started = true;
+  }
+  klbn_radio_hop_update(now_ms);
+
+  klbn_radio_frag_update(now_ms);
+  klbn_radio_batch_update(now_ms);
+  klbn_radio_arq_update(now_ms);
+
+  if (!bench_started && KLBN_RADIO_BENCH_AUTOSTART != KLBN_RADIO_BENCH_NONE &&
+      klbn_radio_scan_done()) {
+    klbn_radio_bench_request(KLBN_RADIO_BENCH_AUTOSTART);
+    bench_started = true;
+  }
+  klbn_radio_bench_update(now_ms);
+
+  // Everything else arrives through the wake semaphore
+  uint32_t next = HUB_MAX_SLEEP_MS;
+  sooner(&next, klbn_radio_scan_next_ms(now_ms));
+  sooner(&next, klbn_radio_rate_next_ms(now_ms));
+  sooner(&next, klbn_radio_hop_next_ms(now_ms));
+  sooner(&next, klbn_radio_frag_next_ms(now_ms));
+  sooner(&next, klbn_radio_batch_next_ms(now_ms));
+  sooner(&next, klbn_radio_arq_next_ms(now_ms));
+  sooner(&next, klbn_radio_bench_next_ms(now_ms));
+  return next;
+}
+
+bool klbn_radio_hub_open_pipe(uint8_t pipe, const uint8_t *address) {
+  return klbn_nrf24l01_module_open_pipe(pipe, address);
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_link_stats.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "libc_stubs.h"
+
+// Rates move 1/4 of the way to each new sample
+#define RATE_SMOOTHING_SHIFT 2
+
+// Averages scaled by 1 << RATE_SMOOTHING_SHIFT, so they settle exactly on
+// a steady sample instead of up to the shift's worth away from it
+typedef struct {
+  uint32_t tx_per_sec;
+  uint32_t rx_per_sec;
+  uint32_t delivery_permille;
+  uint32_t retransmits_x10;
+  uint32_t rpd_permille;
+} link_averages_t;
+
+typedef struct {
+  klbn_radio_link_counters_t counters;
+  klbn_radio_link_counters_t snapshot;  // counters at the last update
+  link_averages_t averages;
+  klbn_radio_link_rates_t rates;
+} link_entry_t;
+
+// Entry KLBN_RADIO_LINK_COUNT holds the radio-wide totals
+static link_entry_t links[KLBN_RADIO_LINK_COUNT + 1];
+static uint32_t last_update_ms = 0;
+
+static link_entry_t *link_entry(uint8_t link) {
+  if (link == KLBN_RADIO_LINK_ALL) {
+    return &links[KLBN_RADIO_LINK_COUNT];
+  }
+  if (link < KLBN_RADIO_LINK_COUNT) {
+    return &links[link];
+  }
+  return NULL;
+}
+
+static uint16_t smooth(uint32_t *average, uint32_t sample) {
+  if (sample > UINT16_MAX) {
+    sample = UINT16_MAX;
+  }
+
+  *average = *average - (*average >> RATE_SMOOTHING_SHIFT) + sample;
+  return (uint16_t)(*average >> RATE_SMOOTHING_SHIFT);
+}
+
+static void update_rates(link_entry_t *entry, uint32_t elapsed_ms) {
+  const klbn_radio_link_counters_t *now = &entry->counters;
+  const klbn_radio_link_counters_t *then = &entry->snapshot;
+  klbn_radio_link_rates_t *rates = &entry->rates;
+  link_averages_t *averages = &entry->averages;
+
+  uint32_t sent = now->sent - then->sent;
+  uint32_t acked = now->acked - then->acked;
+  uint32_t lost = now->lost - then->lost;
+  uint32_t received = now->received - then->received;
+  uint32_t retransmits = now->retransmits - then->retransmits;
+  uint32_t arc_samples = now->arc_samples - then->arc_samples;
+  uint32_t rpd_samples = now->rpd_samples - then->rpd_samples;
+  uint32_t rpd_hits = now->rpd_hits - then->rpd_hits;
+
+  rates->tx_per_sec = smooth(&averages->tx_per_sec, sent * 1000 / elapsed_ms);
+  rates->rx_per_sec =
+      smooth(&averages->rx_per_sec, received * 1000 / elapsed_ms);
+
+  // Ratios only move when there was traffic to measure them on
+  if (acked + lost > 0) {
+    rates->delivery_permille =
+        smooth(&averages->delivery_permille, acked * 1000 / (acked + lost));
+  }
+  if (arc_samples > 0) {
+    rates->retransmits_x10 =
+        smooth(&averages->retransmits_x10, retransmits * 10 / arc_samples);
+  }
+  if (rpd_samples > 0) {
+    rates->rpd_permille =
+        smooth(&averages->rpd_permille, rpd_hits * 1000 / rpd_samples);
+  }
+
+  entry->snapshot = entry->counters;
+}
+
+void klbn_radio_link_stats_init(void) {
+  memset(links, 0, sizeof(links));
+
+  // Assume a healthy link until shown otherwise
+  for (uint8_t i = 0; i <= KLBN_RADIO_LINK_COUNT; i++) {
+    links[i].rates.delivery_permille = 1000;
+    links[i].averages.delivery_permille = 1000 << RATE_SMOOTHING_SHIFT;
+  }
+
+  last_update_ms = 0;
+}
+
+void klbn_radio_link_stats_tx(uint8_t link, bool acked, uint8_t retransmits) {
+  link_entry_t *entry = link_entry(link);
+  link_entry_t *total = &links[KLBN_RADIO_LINK_COUNT];
+
+  if (!entry) {
+    return;
+  }
+
+  entry->counters.sent++;
+  total->counters.sent++;
+
+  if (acked) {
+    entry->counters.acked++;
+    total->counters.acked++;
+
+    // Counting unknown ARC as zero would bias the average low
+    if (retransmits != KLBN_RADIO_RETRANSMITS_UNKNOWN) {
+      entry->counters.retransmits += retransmits;
+      total->counters.retransmits += retransmits;
+      entry->counters.arc_samples++;
+      total->counters.arc_samples++;
+    }
+  } else {
+    entry->counters.lost++;
+    total->counters.lost++;
+  }
+}
+
+void klbn_radio_link_stats_rx(uint8_t link) {
+  link_entry_t *entry = link_entry(link);
+
+  if (!entry) {
+    return;
+  }
+
+  entry->counters.received++;
+  links[KLBN_RADIO_LINK_COUNT].counters.received++;
+}
+
+void klbn_radio_link_stats_rpd(uint8_t link, bool hit) {
+  link_entry_t *entry = link_entry(link);
+  link_entry_t *total = &links[KLBN_RADIO_LINK_COUNT];
+
+  if (!entry) {
+    return;
+  }
+
+  entry->counters.rpd_samples++;
+  total->counters.rpd_samples++;
+
+  if (hit) {
+    entry->counters.rpd_hits++;
+    total->counters.rpd_hits++;
+  }
+}
+
+void klbn_radio_link_stats_overflow(uint32_t count) {
+  // The RX FIFO is shared by all pipes, so this is radio-wide
+  links[KLBN_RADIO_LINK_COUNT].counters.rx_overflows = count;
+}
+
+void klbn_radio_link_stats_update(uint32_t now_ms) {
+  uint32_t elapsed_ms = now_ms - last_update_ms;
+
+  if (elapsed_ms < KLBN_RADIO_LINK_RATE_PERIOD_MS) {
+    return;
+  }
+  last_update_ms = now_ms;
+
+  taskENTER_CRITICAL();
+  for (uint8_t i = 0; i <= KLBN_RADIO_LINK_COUNT; i++) {
+    update_rates(&links[i], elapsed_ms);
+  }
+  taskEXIT_CRITICAL();
+}
+
+bool klbn_radio_link_stats_get(uint8_t link, klbn_radio_link_counters_t *out) {
+  const link_entry_t *entry = link_entry(link);
+
+  if (!entry || !out) {
+    return false;
+  }
+
+  // Readers may run in another task, take a consistent copy
+  taskENTER_CRITICAL();
+  *out = entry->counters;
+  taskEXIT_CRITICAL();
+  return true;
+}
+
+bool klbn_radio_link_stats_get_rates(uint8_t link, klbn_radio_link_rates_t *out) {
+  const link_entry_t *entry = link_entry(link);
+
+  if (!entry || !out) {
+    return false;
+  }
+
+  taskENTER_CRITICAL();
+  *out = entry->rates;
+  taskEXIT_CRITICAL();
+  return true;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_rate.h"
+#include "klbn_radio_hub.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_link_stats.h"
+#include "klbn_nrf24l01_module.h"
+#include "klbn_nrf24l01.h"
+
+#include <stdint.h>
+
+// Decision window and thresholds
+#define RATE_PERIOD_MS           KLBN_RADIO_LINK_RATE_PERIOD_MS
+#define RATE_MIN_SAMPLES         8     // sends per window worth judging
+#define RATE_DOWN_LOSS_PERMILLE  100   // step down above 10% loss
+#define RATE_DOWN_ARC_X10        20    // or above 2 retransmits per packet
+#define RATE_UP_ARC_X10          2     // step up only with almost no retries
+#define RATE_UP_WINDOWS          3     // ... over this many clean windows
+#define RATE_HOLD_WINDOWS        2     // settle time after a change
+
+// Handshake timing
+#define RATE_CONFIRM_TIMEOUT_MS  500   // peer waits this long for CONFIRM
+#define RATE_LINK_TIMEOUT_MS     5000  // silence before falling back to base
+
+// RATE frame: op, level, token
+#define RATE_FRAME_SIZE 3
+
+typedef enum {
+  RATE_OP_PROPOSE = 1,  // sent at the old level, the ACK commits the sender
+  RATE_OP_CONFIRM,      // sent at the new level, commits the receiver
+} rate_op_t;
+
+typedef enum {
+  RATE_STATE_IDLE = 0,
+  RATE_STATE_PROPOSING,     // PROPOSE in flight
+  RATE_STATE_CONFIRMING,    // switched, CONFIRM in flight
+  RATE_STATE_AWAIT_CONFIRM, // switched on the peer's PROPOSE
+} rate_state_t;
+
+typedef struct {
+  klbn_nrf24l01_datarate_t datarate;
+  klbn_nrf24l01_power_t power;
+} rate_level_t;
+
+// Slower rates buy range, lower power on a strong link saves current and
+// interference. The base level matches the driver defaults.
+static const rate_level_t rate_levels[KLBN_RADIO_RATE_LEVELS] = {
+  {KLBN_NRF24L01_DATARATE_250KBPS, KLBN_NRF24L01_POWER_0DBM},
+  {KLBN_NRF24L01_DATARATE_1MBPS, KLBN_NRF24L01_POWER_0DBM},
+  {KLBN_NRF24L01_DATARATE_2MBPS, KLBN_NRF24L01_POWER_0DBM},
+  {KLBN_NRF24L01_DATARATE_2MBPS, KLBN_NRF24L01_POWER_M6DBM},
+  {KLBN_NRF24L01_DATARATE_2MBPS, KLBN_NRF24L01_POWER_M12DBM},
+  {KLBN_NRF24L01_DATARATE_2MBPS, KLBN_NRF24L01_POWER_M18DBM},
+};
+
+static bool rate_enabled = true;
+static rate_state_t rate_state = RATE_STATE_IDLE;
+static uint8_t current_level = KLBN_RADIO_RATE_BASE_LEVEL;
+static uint8_t previous_level = KLBN_RADIO_RATE_BASE_LEVEL;
+static uint8_t target_level = KLBN_RADIO_RATE_BASE_LEVEL;
+static uint8_t rate_token = 0;
+static uint32_t confirm_deadline_ms = 0;
+
+static uint32_t last_window_ms = 0;
+static uint32_t last_activity_ms = 0;
+static uint8_t clean_windows = 0;
+static uint8_t hold_windows = 0;
+static klbn_radio_link_counters_t tx_snapshot;
+static uint32_t activity_snapshot = 0;
+
+static void apply_level(uint8_t level) {
+  current_level = level;
+  klbn_nrf24l01_module_set_rf(rate_levels[level].datarate,
+                              rate_levels[level].power);
+
+  // Judge the new level on its own windows
+  clean_windows = 0;
+  hold_windows = RATE_HOLD_WINDOWS;
+}
+
+static void rate_tx_complete(klbn_radio_tx_result_t result,
+                             uint8_t retransmits, void *context);
+
+static bool send_rate_frame(rate_op_t op, uint8_t level) {
+  uint8_t payload[RATE_FRAME_SIZE] = {(uint8_t)op, level, rate_token};
+
+  // The token and op travel in the context to match the completion
+  uintptr_t tag = ((uintptr_t)op << 8) | rate_token;
+  return klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_RATE, payload,
+                                   RATE_FRAME_SIZE, rate_tx_complete,
+                                   (void *)tag);
+}
+
+static void rate_tx_complete(klbn_radio_tx_result_t result,
+                             uint8_t retransmits, void *context) {
+  (void)retransmits;
+  uintptr_t tag = (uintptr_t)context;
+  rate_op_t op = (rate_op_t)(tag >> 8);
+
+  // Superseded by a newer handshake, or by the peer's proposal
+  if ((uint8_t)tag != rate_token) {
+    return;
+  }
+
+  if (op == RATE_OP_PROPOSE && rate_state == RATE_STATE_PROPOSING) {
+    if (result != KLBN_RADIO_TX_OK) {
+      // The peer never saw it, stay put
+      rate_state = RATE_STATE_IDLE;
+      return;
+    }
+
+    // The peer switched on receipt, follow and confirm at the new level
+    previous_level = current_level;
+    apply_level(target_level);
+    rate_state = RATE_STATE_CONFIRMING;
+    if (!send_rate_frame(RATE_OP_CONFIRM, target_level)) {
+      apply_level(previous_level);
+      rate_state = RATE_STATE_IDLE;
+    }
+  } else if (op == RATE_OP_CONFIRM && rate_state == RATE_STATE_CONFIRMING) {
+    // Unconfirmed, the peer times out and reverts as well
+    if (result != KLBN_RADIO_TX_OK) {
+      apply_level(previous_level);
+    }
+    rate_state = RATE_STATE_IDLE;
+  }
+}
+
+static void propose_level(uint8_t level) {
+  rate_token++;
+  target_level = level;
+  rate_state = RATE_STATE_PROPOSING;
+
+  if (!send_rate_frame(RATE_OP_PROPOSE, level)) {
+    rate_state = RATE_STATE_IDLE;
+  }
+}
+
+static void evaluate_window(void) {
+  klbn_radio_link_counters_t now;
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_TX, &now);
+
+  uint32_t acked = now.acked - tx_snapshot.acked;
+  uint32_t lost = now.lost - tx_snapshot.lost;
+  uint32_t retransmits = now.retransmits - tx_snapshot.retransmits;
+  uint32_t arc_samples = now.arc_samples - tx_snapshot.arc_samples;
+  tx_snapshot = now;
+
+  if (hold_windows > 0) {
+    hold_windows--;
+    return;
+  }
+
+  if (acked + lost < RATE_MIN_SAMPLES) {
+    return;
+  }
+
+  uint32_t loss_permille = lost * 1000 / (acked + lost);
+  // Without an ARC reading in the window only the loss rate can decide
+  bool arc_known = arc_samples > 0;
+  uint32_t arc_x10 = arc_known ? retransmits * 10 / arc_samples : 0;
+
+  if (loss_permille > RATE_DOWN_LOSS_PERMILLE ||
+      (arc_known && arc_x10 > RATE_DOWN_ARC_X10)) {
+    clean_windows = 0;
+    if (current_level > 0) {
+      propose_level(current_level - 1);
+    }
+    return;
+  }
+
+  if (lost == 0 && arc_known && arc_x10 <= RATE_UP_ARC_X10) {
+    if (++clean_windows >= RATE_UP_WINDOWS &&
+        current_level + 1 < KLBN_RADIO_RATE_LEVELS) {
+      clean_windows = 0;
+      propose_level(current_level + 1);
+    }
+  } else {
+    clean_windows = 0;
+  }
+}
+
+void klbn_radio_rate_init(void) {
+  rate_state = RATE_STATE_IDLE;
+  current_level = KLBN_RADIO_RATE_BASE_LEVEL;
+  previous_level = current_level;
+  target_level = current_level;
+  clean_windows = 0;
+  hold_windows = 0;
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_TX, &tx_snapshot);
+}
+
+void klbn_radio_rate_update(uint32_t now_ms) {
+  // Anything acknowledged or received proves the link is alive
+  klbn_radio_link_counters_t total;
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_ALL, &total);
+  if (total.acked + total.received != activity_snapshot) {
+    activity_snapshot = total.acked + total.received;
+    last_activity_ms = now_ms;
+  }
+
+  if (rate_state == RATE_STATE_AWAIT_CONFIRM &&
+      (int32_t)(now_ms - confirm_deadline_ms) >= 0) {
+    apply_level(previous_level);
+    rate_state = RATE_STATE_IDLE;
+  }
+
+  // Both ends lost each other (a CONFIRM whose ACK went missing leaves
+  // them split): meet again on the base level
+  if (rate_state == RATE_STATE_IDLE &&
+      current_level != KLBN_RADIO_RATE_BASE_LEVEL &&
+      (now_ms - last_activity_ms) >= RATE_LINK_TIMEOUT_MS) {
+    apply_level(KLBN_RADIO_RATE_BASE_LEVEL);
+    last_activity_ms = now_ms;
+  }
+
+  if ((now_ms - last_window_ms) < RATE_PERIOD_MS) {
+    return;
+  }
+  last_window_ms = now_ms;
+
+  if (rate_enabled && rate_state == RATE_STATE_IDLE) {
+    evaluate_window();
+  }
+}
+
+void klbn_radio_rate_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint32_t now_ms) {
+  if (!payload || length < RATE_FRAME_SIZE) {
+    return;
+  }
+
+  rate_op_t op = (rate_op_t)payload[0];
+  uint8_t level = payload[1];
+  uint8_t token = payload[2];
+
+  if (level >= KLBN_RADIO_RATE_LEVELS) {
+    return;
+  }
+
+  if (op == RATE_OP_PROPOSE) {
+    // The peer's proposal wins over one of ours still in flight, whose
+    // completion is then ignored by state and token
+    rate_token = token;
+    previous_level = current_level;
+    apply_level(level);
+    rate_state = RATE_STATE_AWAIT_CONFIRM;
+    confirm_deadline_ms = now_ms + RATE_CONFIRM_TIMEOUT_MS;
+  } else if (op == RATE_OP_CONFIRM) {
+    if (rate_state == RATE_STATE_AWAIT_CONFIRM && token == rate_token &&
+        level == current_level) {
+      rate_state = RATE_STATE_IDLE;
+    }
+  }
+}
+
+uint8_t klbn_radio_rate_get_level(void) {
+  return current_level;
+}
+
+void klbn_radio_rate_enable(bool enable) {
+  rate_enabled = enable;
+}
+
+uint32_t klbn_radio_rate_next_ms(uint32_t now_ms) {
+  uint32_t waited = now_ms - last_window_ms;
+  uint32_t next = (waited >= RATE_PERIOD_MS) ? 0 : RATE_PERIOD_MS - waited;
+
+  if (rate_state == RATE_STATE_AWAIT_CONFIRM) {
+    int32_t left = (int32_t)(confirm_deadline_ms - now_ms);
+    if (left <= 0) {
+      return 0;
+    }
+    if ((uint32_t)left < next) {
+      next = (uint32_t)left;
+    }
+  }
+
+  return next;
+}
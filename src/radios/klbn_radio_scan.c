@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_scan.h"
+#include "klbn_radio_hub.h"
+#include "klbn_radio_frame.h"
+#include "klbn_radio_link_stats.h"
+#include "klbn_radio_rate.h"
+#include "klbn_nrf24l01_module.h"
+
+#include <stdint.h>
+
+// Histograms travel as 4-bit levels, 42 channels per SCAN frame
+#define SCAN_PARTS         3
+#define SCAN_PART_CHANNELS (KLBN_RADIO_SCAN_CHANNELS / SCAN_PARTS)
+#define SCAN_PART_BYTES    (SCAN_PART_CHANNELS / 2)
+#define SCAN_FRAME_SIZE    (1 + SCAN_PART_BYTES)
+#define SCAN_PARTS_ALL     ((1 << SCAN_PARTS) - 1)
+#define SCAN_PACKED_BYTES  (KLBN_RADIO_SCAN_CHANNELS / 2)
+
+#define SCAN_RESEND_MS   100   // retry period for unacknowledged parts
+#define SCAN_TIMEOUT_MS  5000  // give up and stay on the boot channel
+#define SCAN_LINGER_MS   300   // keep acking the peer's retries before moving
+
+// Link loss: nothing acked or received for this long sends both ends back
+// to the boot channel to meet again. Longer than the rate engine's own
+// timeout, so both are back on the base rate by then.
+#define SCAN_PROBE_MS    1000  // idle link: a probe's auto-ACK shows the peer
+#define SCAN_LOST_MS     8000
+
+// One byte SCAN frame, too short to be a histogram part
+#define SCAN_PROBE 0xFF
+
+typedef enum {
+  SCAN_STATE_IDLE = 0,
+  SCAN_STATE_EXCHANGE,  // sending our histogram, collecting the peer's
+  SCAN_STATE_LINGER,    // both complete, waiting before the switch
+  SCAN_STATE_DONE,
+} scan_state_t;
+
+static scan_state_t scan_state = SCAN_STATE_IDLE;
+static uint8_t local_levels[SCAN_PACKED_BYTES];
+static uint8_t peer_levels[SCAN_PACKED_BYTES];
+static uint8_t parts_acked = 0;
+static uint8_t parts_in_flight = 0;
+static uint8_t peer_parts = 0;
+static uint8_t chosen_channel = 0;
+static uint8_t boot_channel = 0;
+static uint32_t scan_started_ms = 0;
+static uint32_t linger_started_ms = 0;
+static uint32_t last_send_ms = 0;
+
+static uint32_t last_activity_ms = 0;
+static uint32_t last_probe_ms = 0;
+static uint32_t activity_snapshot = 0;
+
+static uint8_t level_get(const uint8_t *packed, uint8_t channel) {
+  uint8_t byte = packed[channel / 2];
+  return (channel & 1) ? (byte >> 4) : (byte & 0x0F);
+}
+
+static void level_set(uint8_t *packed, uint8_t channel, uint8_t level) {
+  uint8_t *byte = &packed[channel / 2];
+
+  if (channel & 1) {
+    *byte = (*byte & 0x0F) | (level << 4);
+  } else {
+    *byte = (*byte & 0xF0) | (level & 0x0F);
+  }
+}
+
+// Weighted by the busier end, so one side's Wi-Fi is not averaged away
+static uint16_t channel_busy(uint8_t channel) {
+  uint8_t a = level_get(local_levels, channel);
+  uint8_t b = level_get(peer_levels, channel);
+  uint8_t busier = (a > b) ? a : b;
+
+  return (uint16_t)busier * (2 * KLBN_RADIO_SCAN_LEVEL_MAX + 1) + a + b;
+}
+
+// Both ends hold the same two histograms and run the same pure function
+// over them, so they pick the same channel without a further round trip
+static uint8_t choose_channel(void) {
+  uint8_t best = 0;
+  uint32_t best_cost = UINT32_MAX;
+
+  for (uint8_t ch = 0; ch < KLBN_RADIO_SCAN_CHANNELS; ch++) {
+    // A 2 Mbps signal spills into the neighbouring channels
+    uint16_t below = channel_busy((ch > 0) ? ch - 1 : ch);
+    uint16_t above =
+        channel_busy((ch + 1 < KLBN_RADIO_SCAN_CHANNELS) ? ch + 1 : ch);
+    uint32_t cost = 2 * (uint32_t)channel_busy(ch) + below + above;
+
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = ch;
+    }
+  }
+
+  return best;
+}
+
+static void scan_tx_complete(klbn_radio_tx_result_t result,
+                             uint8_t retransmits, void *context) {
+  (void)retransmits;
+  uint8_t bit = 1 << (uint8_t)(uintptr_t)context;
+
+  parts_in_flight &= ~bit;
+  if (result == KLBN_RADIO_TX_OK) {
+    parts_acked |= bit;
+  }
+}
+
+static void send_parts(void) {
+  for (uint8_t part = 0; part < SCAN_PARTS; part++) {
+    uint8_t bit = 1 << part;
+    uint8_t payload[SCAN_FRAME_SIZE];
+
+    if ((parts_acked | parts_in_flight) & bit) {
+      continue;
+    }
+
+    payload[0] = part;
+    for (uint8_t i = 0; i < SCAN_PART_BYTES; i++) {
+      payload[1 + i] = local_levels[part * SCAN_PART_BYTES + i];
+    }
+
+    if (klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_SCAN, payload,
+                                  SCAN_FRAME_SIZE, scan_tx_complete,
+                                  (void *)(uintptr_t)part)) {
+      parts_in_flight |= bit;
+    }
+  }
+}
+
+static void finish(uint32_t now_ms) {
+  scan_state = SCAN_STATE_DONE;
+  last_activity_ms = now_ms;
+  last_probe_ms = now_ms;
+  klbn_radio_rate_enable(true);
+}
+
+// Exchange the histogram from the last sweep on the current channel
+static void begin_exchange(uint32_t now_ms) {
+  // Rate changes would race the exchange
+  klbn_radio_rate_enable(false);
+
+  parts_acked = 0;
+  parts_in_flight = 0;
+  peer_parts = 0;
+  scan_started_ms = now_ms;
+  last_send_ms = now_ms - SCAN_RESEND_MS;
+  scan_state = SCAN_STATE_EXCHANGE;
+}
+
+// Anything acknowledged or received proves the link is alive
+static void track_activity(uint32_t now_ms) {
+  klbn_radio_link_counters_t total;
+
+  klbn_radio_link_stats_get(KLBN_RADIO_LINK_ALL, &total);
+  if (total.acked + total.received != activity_snapshot) {
+    activity_snapshot = total.acked + total.received;
+    last_activity_ms = now_ms;
+  }
+}
+
+static void send_probe(uint32_t now_ms) {
+  uint8_t probe = SCAN_PROBE;
+
+  last_probe_ms = now_ms;
+  klbn_radio_hub_send_frame(KLBN_RADIO_FRAME_SCAN, &probe, sizeof(probe),
+                            NULL, NULL);
+}
+
+void klbn_radio_scan_sweep(uint8_t samples, uint8_t *occupancy) {
+  if (!occupancy || samples == 0) {
+    return;
+  }
+
+  for (uint8_t ch = 0; ch < KLBN_RADIO_SCAN_CHANNELS; ch++) {
+    uint8_t hits = klbn_nrf24l01_module_sample_channel(ch, samples);
+
+    // Round up, a single hit must not read as a clean channel
+    occupancy[ch] =
+        ((uint16_t)hits * KLBN_RADIO_SCAN_LEVEL_MAX + samples - 1) / samples;
+  }
+}
+
+void klbn_radio_scan_start(uint32_t now_ms) {
+  uint8_t occupancy[KLBN_RADIO_SCAN_CHANNELS];
+
+  klbn_radio_scan_sweep(KLBN_RADIO_SCAN_SAMPLES, occupancy);
+  for (uint8_t ch = 0; ch < KLBN_RADIO_SCAN_CHANNELS; ch++) {
+    level_set(local_levels, ch, occupancy[ch]);
+  }
+
+  boot_channel = klbn_nrf24l01_module_get_channel();
+  begin_exchange(now_ms);
+}
+
+void klbn_radio_scan_update(uint32_t now_ms) {
+  switch (scan_state) {
+  case SCAN_STATE_EXCHANGE:
+    if (parts_acked == SCAN_PARTS_ALL && peer_parts == SCAN_PARTS_ALL) {
+      chosen_channel = choose_channel();
+      linger_started_ms = now_ms;
+      scan_state = SCAN_STATE_LINGER;
+      break;
+    }
+
+    if ((now_ms - scan_started_ms) >= SCAN_TIMEOUT_MS) {
+      // No peer answered, stay where any late node will look for us
+      finish(now_ms);
+      break;
+    }
+
+    if ((now_ms - last_send_ms) >= SCAN_RESEND_MS) {
+      last_send_ms = now_ms;
+      send_parts();
+    }
+    break;
+
+  case SCAN_STATE_LINGER:
+    if ((now_ms - linger_started_ms) >= SCAN_LINGER_MS) {
+      klbn_nrf24l01_module_set_channel(chosen_channel);
+      finish(now_ms);
+    }
+    break;
+
+  case SCAN_STATE_DONE:
+    track_activity(now_ms);
+
+    if ((now_ms - last_activity_ms) >= SCAN_LOST_MS) {
+      // The peer rebooted, or moved without us: look for it where a
+      // booting node starts. The old sweep is reused, a new one would
+      // stall the hub task for its length.
+      klbn_nrf24l01_module_set_channel(boot_channel);
+      begin_exchange(now_ms);
+      break;
+    }
+
+    if ((now_ms - last_activity_ms) >= SCAN_PROBE_MS &&
+        (now_ms - last_probe_ms) >= SCAN_PROBE_MS) {
+      send_probe(now_ms);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void klbn_radio_scan_handle_frame(const uint8_t *payload, uint8_t length,
+                                  uint32_t now_ms) {
+  // Probes only need their auto-ACK
+  if (!payload || length < SCAN_FRAME_SIZE || scan_state == SCAN_STATE_IDLE) {
+    return;
+  }
+
+  uint8_t part = payload[0];
+  if (part >= SCAN_PARTS) {
+    return;
+  }
+
+  // A peer that booted or lost us is exchanging on the boot channel:
+  // answer with our histogram
+  if (scan_state == SCAN_STATE_DONE) {
+    if (klbn_nrf24l01_module_get_channel() != boot_channel) {
+      return;
+    }
+    begin_exchange(now_ms);
+  }
+
+  for (uint8_t i = 0; i < SCAN_PART_BYTES; i++) {
+    peer_levels[part * SCAN_PART_BYTES + i] = payload[1 + i];
+  }
+  peer_parts |= 1 << part;
+}
+
+bool klbn_radio_scan_done(void) {
+  return scan_state == SCAN_STATE_DONE;
+}
+
+uint8_t klbn_radio_scan_get_occupancy(uint8_t channel) {
+  if (channel >= KLBN_RADIO_SCAN_CHANNELS) {
+    return 0;
+  }
+
+  return level_get(local_levels, channel);
+}
+
+uint32_t klbn_radio_scan_next_ms(uint32_t now_ms) {
+  uint32_t waited;
+
+  switch (scan_state) {
+  case SCAN_STATE_EXCHANGE:
+    // Completion and peer parts arrive by IRQ; retries run on the clock
+    waited = now_ms - last_send_ms;
+    return (waited >= SCAN_RESEND_MS) ? 0 : SCAN_RESEND_MS - waited;
+
+  case SCAN_STATE_LINGER:
+    waited = now_ms - linger_started_ms;
+    return (waited >= SCAN_LINGER_MS) ? 0 : SCAN_LINGER_MS - waited;
+
+  case SCAN_STATE_DONE: {
+    // Next probe, or the loss timeout once probing
+    uint32_t since = ((now_ms - last_probe_ms) < (now_ms - last_activity_ms))
+                         ? last_probe_ms
+                         : last_activity_ms;
+    waited = now_ms - since;
+    return (waited >= SCAN_PROBE_MS) ? 0 : SCAN_PROBE_MS - waited;
+  }
+
+  default:
+    return UINT32_MAX;
+  }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
+ *
+ * This file is part of Kelbaran.
+ *
+ * Kelbaran is released under the GNU General Public License v3 (GPL-3.0).
+ * See LICENSE file for details.
+ */
+
+#include "klbn_radio_sched.h"
+#include "klbn_radio_hub.h"
+#include "klbn_rtos.h"
+
+#include <stdint.h>
+
+static QueueHandle_t class_queues[KLBN_RADIO_CLASS_COUNT];
+static SemaphoreHandle_t sched_wake = NULL;
+static klbn_radio_class_stats_t class_stats[KLBN_RADIO_CLASS_COUNT];
+
+static const uint8_t class_depth[KLBN_RADIO_CLASS_COUNT] = {
+  KLBN_RADIO_SCHED_CONTROL_DEPTH,
+  KLBN_RADIO_SCHED_INTERACTIVE_DEPTH,
+  KLBN_RADIO_SCHED_BULK_DEPTH,
+};
+
+#ifdef KLBN_STATIC_ALLOCATION
+// All three queues share one storage area, class by class
+static uint8_t class_storage[(KLBN_RADIO_SCHED_CONTROL_DEPTH +
+                              KLBN_RADIO_SCHED_INTERACTIVE_DEPTH +
+                              KLBN_RADIO_SCHED_BULK_DEPTH) *
+                             sizeof(klbn_radio_command_t)];
+static StaticQueue_t class_queue_structs[KLBN_RADIO_CLASS_COUNT];
+
+static const uint8_t class_first[KLBN_RADIO_CLASS_COUNT] = {
+  0,
+  KLBN_RADIO_SCHED_CONTROL_DEPTH,
+  KLBN_RADIO_SCHED_CONTROL_DEPTH + KLBN_RADIO_SCHED_INTERACTIVE_DEPTH,
+};
+#endif
+
+static const uint8_t class_weight[KLBN_RADIO_CLASS_COUNT] = {
+  0,   // strict priority, not weighted
+  KLBN_RADIO_SCHED_INTERACTIVE_WEIGHT,
+  KLBN_RADIO_SCHED_BULK_WEIGHT,
+};
+
+// Weighted round robin between the non-control classes
+static klbn_radio_class_t wrr_class = KLBN_RADIO_CLASS_INTERACTIVE;
+static uint8_t wrr_credit = KLBN_RADIO_SCHED_INTERACTIVE_WEIGHT;
+
+static bool class_waiting(klbn_radio_class_t cls) {
+  return uxQueueMessagesWaiting(class_queues[cls]) > 0;
+}
+
+static void wrr_next(void) {
+  wrr_class = (wrr_class == KLBN_RADIO_CLASS_INTERACTIVE)
+                  ? KLBN_RADIO_CLASS_BULK
+                  : KLBN_RADIO_CLASS_INTERACTIVE;
+  wrr_credit = class_weight[wrr_class];
+}
+
+static klbn_radio_class_t pick_class(void) {
+  if (class_waiting(KLBN_RADIO_CLASS_CONTROL)) {
+    return KLBN_RADIO_CLASS_CONTROL;
+  }
+
+  // An idle class gives up its turn rather than holding credit
+  if (wrr_credit == 0 || !class_waiting(wrr_class)) {
+    wrr_next();
+  }
+
+  // Never idle with work queued: a spent class goes on with fresh credit
+  // while the other one is empty
+  if (!class_waiting(wrr_class)) {
+    wrr_next();
+    if (!class_waiting(wrr_class)) {
+      return KLBN_RADIO_CLASS_COUNT;
+    }
+  }
+  return wrr_class;
+}
+
+void klbn_radio_sched_init(SemaphoreHandle_t wake) {
+  sched_wake = wake;
+
+  for (uint8_t i = 0; i < KLBN_RADIO_CLASS_COUNT; i++) {
+    if (class_queues[i] == NULL) {
+      class_queues[i] = KLBN_QUEUE_CREATE(
+          class_depth[i], sizeof(klbn_radio_command_t),
+          &class_storage[class_first[i] * sizeof(klbn_radio_command_t)],
+          &class_queue_structs[i]);
+      configASSERT(class_queues[i] != NULL);
+    }
+  }
+}
+
+bool klbn_radio_sched_enqueue(const klbn_radio_command_t *cmd,
+                              klbn_radio_class_t cls) {
+  if (!cmd || cls >= KLBN_RADIO_CLASS_COUNT || class_queues[cls] == NULL) {
+    return false;
+  }
+
+  if (cmd->length > KLBN_RADIO_HUB_RELIABLE_MAX ||
+      xQueueSendToBack(class_queues[cls], cmd, 0) != pdPASS) {
+    class_stats[cls].dropped++;
+    return false;
+  }
+
+  class_stats[cls].queued++;
+  if (sched_wake != NULL) {
+    xSemaphoreGive(sched_wake);
+  }
+  return true;
+}
+
+uint8_t klbn_radio_sched_room(klbn_radio_class_t cls) {
+  if (cls >= KLBN_RADIO_CLASS_COUNT || class_queues[cls] == NULL) {
+    return 0;
+  }
+
+  return (uint8_t)uxQueueSpacesAvailable(class_queues[cls]);
+}
+
+void klbn_radio_sched_service(klbn_radio_sched_send_t send) {
+  klbn_radio_command_t cmd;
+
+  if (!send) {
+    return;
+  }
+
+  for (;;) {
+    klbn_radio_class_t cls = pick_class();
+
+    if (cls == KLBN_RADIO_CLASS_COUNT ||
+        xQueuePeek(class_queues[cls], &cmd, 0) != pdPASS ||
+        !send(&cmd, cls == KLBN_RADIO_CLASS_CONTROL)) {
+      return;
+    }
+
+    xQueueReceive(class_queues[cls], &cmd, 0);
+    class_stats[cls].sent++;
+    if (cls != KLBN_RADIO_CLASS_CONTROL) {
+      wrr_credit--;
+    }
+  }
+}
+
+void klbn_radio_sched_get_stats(klbn_radio_class_t cls,
+                                klbn_radio_class_stats_t *out) {
+  if (!out || cls >= KLBN_RADIO_CLASS_COUNT) {
+    return;
+  }
+
+  *out = class_stats[cls];
+}
@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) 2025 Masoud Bolhassani <masoud.bolhassani@gmail.com>
  *
@@ -9,18 +8,150 @@
  */
 
 #include "klbn_sensor_hub.h"
+#include "stm32f1xx.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define JITTER_SHIFT 4   // smoothing weight 1/16 per wakeup
+
+typedef bool (*sensor_read_t)(klbn_sensor_data_t *out);
+
+typedef struct {
+  sensor_read_t read;
+  TickType_t period;
+  TickType_t next_due;
+} sensor_slot_t;
+
+static bool read_heartbeat(klbn_sensor_data_t *out) {
+  // TODO: Read sensor data
+  (void)out;
+  return true;
+}
+
+static sensor_slot_t sensors[KLBN_SENSOR_COUNT] = {
+  [KLBN_SENSOR_HEARTBEAT] = {read_heartbeat, pdMS_TO_TICKS(100), 0},
+};
+
+static klbn_sensor_hub_timing_t timing;
+static uint32_t last_wake_cycles = 0;
+static TickType_t last_deadline = 0;
+static bool have_last_wake = false;
+
+static void record_jitter(TickType_t deadline) {
+  uint32_t now = DWT->CYCCNT;
+
+  if (have_last_wake) {
+    uint32_t interval_us = (now - last_wake_cycles) / (SystemCoreClock / 1000000);
+    uint32_t expected_us = (deadline - last_deadline) * portTICK_PERIOD_MS * 1000;
+    int32_t jitter = (int32_t)(interval_us - expected_us);
+    uint32_t magnitude = (jitter < 0) ? (uint32_t)-jitter : (uint32_t)jitter;
+
+    taskENTER_CRITICAL();
+    if (jitter < timing.jitter_min_us) {
+      timing.jitter_min_us = jitter;
+    }
+    if (jitter > timing.jitter_max_us) {
+      timing.jitter_max_us = jitter;
+    }
+    timing.jitter_avg_us = timing.jitter_avg_us +
+                           ((int32_t)(magnitude - timing.jitter_avg_us) >> JITTER_SHIFT);
+    taskEXIT_CRITICAL();
+  }
+
+  last_wake_cycles = now;
+  last_deadline = deadline;
+  have_last_wake = true;
+}
 
 void klbn_sensor_hub_init(void) {
-  // Sensor hub initialization
+  TickType_t now = xTaskGetTickCount();
+
+  for (uint8_t i = 0; i < KLBN_SENSOR_COUNT; i++) {
+    sensors[i].next_due = now;
+  }
+  klbn_sensor_hub_reset_timing();
 }
 
-bool klbn_sensor_hub_read(klbn_sensor_data_t *out) {
-  if (!out) {
+bool klbn_sensor_hub_set_period(klbn_sensor_id_t sensor, uint32_t period_ms) {
+  if (sensor >= KLBN_SENSOR_COUNT || pdMS_TO_TICKS(period_ms) == 0) {
     return false;
   }
 
-  // TODO: Read sensor data
+  taskENTER_CRITICAL();
+  sensors[sensor].period = pdMS_TO_TICKS(period_ms);
+  taskEXIT_CRITICAL();
   return true;
 }
+
+TickType_t klbn_sensor_hub_next_due(void) {
+  TickType_t next = sensors[0].next_due;
+
+  for (uint8_t i = 1; i < KLBN_SENSOR_COUNT; i++) {
+    if ((int32_t)(sensors[i].next_due - next) < 0) {
+      next = sensors[i].next_due;
+    }
+  }
+  return next;
+}
+
+uint8_t klbn_sensor_hub_sample(TickType_t deadline, bool on_time,
+                               klbn_sensor_data_t out[KLBN_SENSOR_COUNT]) {
+  uint8_t count = 0;
+
+  record_jitter(deadline);
+
+  taskENTER_CRITICAL();
+  timing.periods++;
+  if (!on_time) {
+    timing.overruns++;
+  }
+  taskEXIT_CRITICAL();
+
+  for (uint8_t i = 0; i < KLBN_SENSOR_COUNT; i++) {
+    sensor_slot_t *slot = &sensors[i];
+
+    if ((int32_t)(deadline - slot->next_due) < 0) {
+      continue;
+    }
+
+    // Due times stay on the sensor's own grid, a late tick does not
+    // shift the ones after it
+    slot->next_due += slot->period;
+    while ((int32_t)(deadline - slot->next_due) >= 0) {
+      slot->next_due += slot->period;
+      timing.skipped++;
+    }
+
+    klbn_sensor_data_t *sample = &out[count];
+    sample->sensor = (klbn_sensor_id_t)i;
+    sample->timestamp = deadline;
+    if (slot->read(sample)) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+void klbn_sensor_hub_get_timing(klbn_sensor_hub_timing_t *out) {
+  if (!out) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  *out = timing;
+  taskEXIT_CRITICAL();
+}
+
+void klbn_sensor_hub_reset_timing(void) {
+  taskENTER_CRITICAL();
+  timing.periods = 0;
+  timing.overruns = 0;
+  timing.skipped = 0;
+  timing.jitter_min_us = INT32_MAX;
+  timing.jitter_max_us = INT32_MIN;
+  timing.jitter_avg_us = 0;
+  have_last_wake = false;
+  taskEXIT_CRITICAL();
+}
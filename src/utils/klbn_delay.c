@@ -14,22 +14,17 @@
 static uint32_t ticks_per_us;
 
 void klbn_delay_init(void) {
-  // SysTick clock frequency = SystemCoreClock (Hz)
-  // Calculate ticks per microsecond
+  // Cycle counter runs at SystemCoreClock (Hz), enabled by klbn_board_init().
+  // SysTick is left to the FreeRTOS tick.
   ticks_per_us = SystemCoreClock / 1000000;
-
-  // Configure SysTick for simple countdown (no interrupt)
-  SysTick->LOAD = 0xFFFFFF; // Max reload value
-  SysTick->VAL = 0;         // Clear current value
-  SysTick->CTRL = SysTick_CTRL_ENABLE_Msk;
 }
 
 void klbn_delay_us(uint32_t us) {
-  uint32_t start_tick = SysTick->VAL;
+  uint32_t start_tick = DWT->CYCCNT;
   uint32_t ticks = us * ticks_per_us;
 
-  // SysTick counts down, so compute target count
-  while ((start_tick - SysTick->VAL) < ticks) {
+  // CYCCNT counts up and wraps, unsigned subtraction handles the wrap
+  while ((DWT->CYCCNT - start_tick) < ticks) {
     // wait
   }
 }